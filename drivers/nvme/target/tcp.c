@@ -11,6 +11,7 @@
 #include <linux/nvme-tcp.h>
 #include <net/sock.h>
 #include <net/tcp.h>
+#include <net/busy_poll.h>
 #include <linux/inet.h>
 #include <linux/llist.h>
 #include <crypto/hash.h>
@@ -40,6 +41,7 @@ MODULE_PARM_DESC(idle_poll_period_usecs,
 		"nvmet tcp io_work poll till idle time period in usecs");
 
 #define NVMET_TCP_RECV_BUDGET		8
+#define NVMET_TCP_RECV_BUDGET_MAX	32
 #define NVMET_TCP_SEND_BUDGET		8
 #define NVMET_TCP_IO_WORK_BUDGET	64
 
@@ -130,6 +132,7 @@ struct nvmet_tcp_queue {
 	struct ahash_request	*rcv_hash;
 
 	unsigned long           poll_end;
+	int			recv_budget;
 
 	spinlock_t		state_lock;
 	enum nvmet_tcp_queue_state state;
@@ -1291,21 +1294,50 @@ static bool nvmet_tcp_check_queue_deadline(struct nvmet_tcp_queue *queue,
 	return !time_after(jiffies, queue->poll_end);
 }
 
+/*
+ * Grow the receive budget while the socket keeps delivering a full budget
+ * worth of PDUs per pass, so that a busy queue drains more of them before
+ * yielding to the send side, and shrink it back once the load drops.
+ */
+static void nvmet_tcp_adjust_recv_budget(struct nvmet_tcp_queue *queue,
+		int recvs)
+{
+	if (recvs >= queue->recv_budget)
+		queue->recv_budget = min(queue->recv_budget * 2,
+					 NVMET_TCP_RECV_BUDGET_MAX);
+	else if (recvs < queue->recv_budget / 2)
+		queue->recv_budget = max(queue->recv_budget / 2,
+					 NVMET_TCP_RECV_BUDGET);
+}
+
+static inline void nvmet_tcp_busy_poll(struct nvmet_tcp_queue *queue)
+{
+	struct sock *sk = queue->sock->sk;
+
+	if (sk_can_busy_loop(sk) &&
+	    skb_queue_empty_lockless(&sk->sk_receive_queue))
+		sk_busy_loop(sk, true);
+}
+
 static void nvmet_tcp_io_work(struct work_struct *w)
 {
 	struct nvmet_tcp_queue *queue =
 		container_of(w, struct nvmet_tcp_queue, io_work);
 	bool pending;
-	int ret, ops = 0;
+	int ret, prev_ops, ops = 0;
+
+	nvmet_tcp_busy_poll(queue);
 
 	do {
 		pending = false;
 
-		ret = nvmet_tcp_try_recv(queue, NVMET_TCP_RECV_BUDGET, &ops);
+		prev_ops = ops;
+		ret = nvmet_tcp_try_recv(queue, queue->recv_budget, &ops);
 		if (ret > 0)
 			pending = true;
 		else if (ret < 0)
 			return;
+		nvmet_tcp_adjust_recv_budget(queue, ops - prev_ops);
 
 		ret = nvmet_tcp_try_send(queue, NVMET_TCP_SEND_BUDGET, &ops);
 		if (ret > 0)
@@ -1607,6 +1639,7 @@ static int nvmet_tcp_alloc_queue(struct nvmet_tcp_port *port,
 	queue->sock = newsock;
 	queue->port = port;
 	queue->nr_cmds = 0;
+	queue->recv_budget = NVMET_TCP_RECV_BUDGET;
 	spin_lock_init(&queue->state_lock);
 	queue->state = NVMET_TCP_Q_CONNECTING;
 	INIT_LIST_HEAD(&queue->free_list);
@@ -185,14 +185,16 @@ void vhost_work_init(struct vhost_work *work, vhost_work_fn_t fn)
 }
 EXPORT_SYMBOL_GPL(vhost_work_init);
 
-/* Init poll structure */
+/* Init poll structure. Works of a poll with a @vq run on that vq's worker. */
 void vhost_poll_init(struct vhost_poll *poll, vhost_work_fn_t fn,
-		     __poll_t mask, struct vhost_dev *dev)
+		     __poll_t mask, struct vhost_dev *dev,
+		     struct vhost_virtqueue *vq)
 {
 	init_waitqueue_func_entry(&poll->wait, vhost_poll_wakeup);
 	init_poll_funcptr(&poll->table, vhost_poll_func);
 	poll->mask = mask;
 	poll->dev = dev;
+	poll->vq = vq;
 	poll->wqh = NULL;
 
 	vhost_work_init(&poll->work, fn);
@@ -231,17 +233,36 @@ void vhost_poll_stop(struct vhost_poll *poll)
 }
 EXPORT_SYMBOL_GPL(vhost_poll_stop);
 
-void vhost_work_dev_flush(struct vhost_dev *dev)
+static void vhost_worker_queue(struct vhost_worker *worker,
+			       struct vhost_work *work)
+{
+	if (!test_and_set_bit(VHOST_WORK_QUEUED, &work->flags)) {
+		/* We can only add the work to the list after we're
+		 * sure it was not in the list.
+		 * test_and_set_bit() implies a memory barrier.
+		 */
+		llist_add(&work->node, &worker->work_list);
+		wake_up_process(worker->task);
+	}
+}
+
+static void vhost_worker_flush(struct vhost_worker *worker)
 {
 	struct vhost_flush_struct flush;
 
-	if (dev->worker) {
-		init_completion(&flush.wait_event);
-		vhost_work_init(&flush.work, vhost_flush_work);
+	init_completion(&flush.wait_event);
+	vhost_work_init(&flush.work, vhost_flush_work);
 
-		vhost_work_queue(dev, &flush.work);
-		wait_for_completion(&flush.wait_event);
-	}
+	vhost_worker_queue(worker, &flush.work);
+	wait_for_completion(&flush.wait_event);
+}
+
+void vhost_work_dev_flush(struct vhost_dev *dev)
+{
+	int i;
+
+	for (i = 0; i < dev->nworkers; i++)
+		vhost_worker_flush(&dev->workers[i]);
 }
 EXPORT_SYMBOL_GPL(vhost_work_dev_flush);
 
@@ -253,32 +274,51 @@ void vhost_poll_flush(struct vhost_poll *poll)
 }
 EXPORT_SYMBOL_GPL(vhost_poll_flush);
 
+/* Works not tied to a virtqueue run on the device's first worker. */
 void vhost_work_queue(struct vhost_dev *dev, struct vhost_work *work)
 {
-	if (!dev->worker)
+	if (!dev->workers)
 		return;
 
-	if (!test_and_set_bit(VHOST_WORK_QUEUED, &work->flags)) {
-		/* We can only add the work to the list after we're
-		 * sure it was not in the list.
-		 * test_and_set_bit() implies a memory barrier.
-		 */
-		llist_add(&work->node, &dev->work_list);
-		wake_up_process(dev->worker);
-	}
+	vhost_worker_queue(&dev->workers[0], work);
 }
 EXPORT_SYMBOL_GPL(vhost_work_queue);
 
+void vhost_vq_work_queue(struct vhost_virtqueue *vq, struct vhost_work *work)
+{
+	if (!vq->worker)
+		return;
+
+	vhost_worker_queue(vq->worker, work);
+}
+EXPORT_SYMBOL_GPL(vhost_vq_work_queue);
+
 /* A lockless hint for busy polling code to exit the loop */
 bool vhost_has_work(struct vhost_dev *dev)
 {
-	return !llist_empty(&dev->work_list);
+	int i;
+
+	for (i = 0; i < dev->nworkers; i++)
+		if (!llist_empty(&dev->workers[i].work_list))
+			return true;
+
+	return false;
 }
 EXPORT_SYMBOL_GPL(vhost_has_work);
 
+/* Same as vhost_has_work(), but only for the worker running @vq */
+bool vhost_vq_has_work(struct vhost_virtqueue *vq)
+{
+	return vq->worker && !llist_empty(&vq->worker->work_list);
+}
+EXPORT_SYMBOL_GPL(vhost_vq_has_work);
+
 void vhost_poll_queue(struct vhost_poll *poll)
 {
-	vhost_work_queue(poll->dev, &poll->work);
+	if (poll->vq)
+		vhost_vq_work_queue(poll->vq, &poll->work);
+	else
+		vhost_work_queue(poll->dev, &poll->work);
 }
 EXPORT_SYMBOL_GPL(vhost_poll_queue);
 
@@ -288,6 +328,8 @@ static void __vhost_vq_meta_reset(struct vhost_virtqueue *vq)
 
 	for (j = 0; j < VHOST_NUM_ADDRS; j++)
 		vq->meta_iotlb[j] = NULL;
+	for (j = 0; j < VHOST_IOTLB_CACHE_SIZE; j++)
+		vq->iotlb_cache[j] = NULL;
 }
 
 static void vhost_vq_meta_reset(struct vhost_dev *d)
@@ -343,7 +385,8 @@ static void vhost_vq_reset(struct vhost_dev *dev,
 
 static int vhost_worker(void *data)
 {
-	struct vhost_dev *dev = data;
+	struct vhost_worker *worker = data;
+	struct vhost_dev *dev = worker->dev;
 	struct vhost_work *work, *work_next;
 	struct llist_node *node;
 
@@ -358,7 +401,7 @@ static int vhost_worker(void *data)
 			break;
 		}
 
-		node = llist_del_all(&dev->work_list);
+		node = llist_del_all(&worker->work_list);
 		if (!node)
 			schedule();
 
@@ -481,13 +524,14 @@ void vhost_dev_init(struct vhost_dev *dev,
 	dev->umem = NULL;
 	dev->iotlb = NULL;
 	dev->mm = NULL;
-	dev->worker = NULL;
+	dev->workers = NULL;
+	dev->nworkers = 0;
+	dev->vqs_per_worker = 0;
 	dev->iov_limit = iov_limit;
 	dev->weight = weight;
 	dev->byte_weight = byte_weight;
 	dev->use_worker = use_worker;
 	dev->msg_handler = msg_handler;
-	init_llist_head(&dev->work_list);
 	init_waitqueue_head(&dev->wait);
 	INIT_LIST_HEAD(&dev->read_list);
 	INIT_LIST_HEAD(&dev->pending_list);
@@ -500,11 +544,12 @@ void vhost_dev_init(struct vhost_dev *dev,
 		vq->indirect = NULL;
 		vq->heads = NULL;
 		vq->dev = dev;
+		vq->worker = NULL;
 		mutex_init(&vq->mutex);
 		vhost_vq_reset(dev, vq);
 		if (vq->handle_kick)
 			vhost_poll_init(&vq->poll, vq->handle_kick,
-					EPOLLIN, dev);
+					EPOLLIN, dev, vq);
 	}
 }
 EXPORT_SYMBOL_GPL(vhost_dev_init);
@@ -534,12 +579,75 @@ static void vhost_attach_cgroups_work(struct vhost_work *work)
 static int vhost_attach_cgroups(struct vhost_dev *dev)
 {
 	struct vhost_attach_cgroups_struct attach;
+	int i;
 
 	attach.owner = current;
-	vhost_work_init(&attach.work, vhost_attach_cgroups_work);
-	vhost_work_queue(dev, &attach.work);
-	vhost_work_dev_flush(dev);
-	return attach.ret;
+	for (i = 0; i < dev->nworkers; i++) {
+		vhost_work_init(&attach.work, vhost_attach_cgroups_work);
+		vhost_worker_queue(&dev->workers[i], &attach.work);
+		vhost_worker_flush(&dev->workers[i]);
+		if (attach.ret)
+			return attach.ret;
+	}
+	return 0;
+}
+
+static void vhost_workers_free(struct vhost_dev *dev)
+{
+	int i;
+
+	for (i = 0; i < dev->nvqs; i++)
+		dev->vqs[i]->worker = NULL;
+
+	for (i = 0; i < dev->nworkers; i++) {
+		WARN_ON(!llist_empty(&dev->workers[i].work_list));
+		kthread_stop(dev->workers[i].task);
+	}
+
+	kfree(dev->workers);
+	dev->workers = NULL;
+	dev->nworkers = 0;
+}
+
+static int vhost_workers_create(struct vhost_dev *dev)
+{
+	struct vhost_worker *worker;
+	struct task_struct *task;
+	int i, nworkers = 1;
+
+	if (dev->vqs_per_worker)
+		nworkers = DIV_ROUND_UP(dev->nvqs, dev->vqs_per_worker);
+
+	dev->workers = kcalloc(nworkers, sizeof(*dev->workers),
+			       GFP_KERNEL_ACCOUNT);
+	if (!dev->workers)
+		return -ENOMEM;
+
+	for (i = 0; i < nworkers; i++) {
+		worker = &dev->workers[i];
+		init_llist_head(&worker->work_list);
+		worker->dev = dev;
+
+		task = kthread_create(vhost_worker, worker,
+				      "vhost-%d", current->pid);
+		if (IS_ERR(task)) {
+			vhost_workers_free(dev);
+			return PTR_ERR(task);
+		}
+
+		worker->task = task;
+		dev->nworkers++;
+		wake_up_process(task); /* avoid contributing to loadavg */
+	}
+
+	for (i = 0; i < dev->nvqs; i++) {
+		worker = &dev->workers[0];
+		if (dev->vqs_per_worker)
+			worker = &dev->workers[i / dev->vqs_per_worker];
+		dev->vqs[i]->worker = worker;
+	}
+
+	return 0;
 }
 
 /* Caller should have device mutex */
@@ -582,7 +690,6 @@ static void vhost_detach_mm(struct vhost_dev *dev)
 /* Caller should have device mutex */
 long vhost_dev_set_owner(struct vhost_dev *dev)
 {
-	struct task_struct *worker;
 	int err;
 
 	/* Is there an owner already? */
@@ -595,15 +702,9 @@ long vhost_dev_set_owner(struct vhost_dev *dev)
 
 	dev->kcov_handle = kcov_common_handle();
 	if (dev->use_worker) {
-		worker = kthread_create(vhost_worker, dev,
-					"vhost-%d", current->pid);
-		if (IS_ERR(worker)) {
-			err = PTR_ERR(worker);
+		err = vhost_workers_create(dev);
+		if (err)
 			goto err_worker;
-		}
-
-		dev->worker = worker;
-		wake_up_process(worker); /* avoid contributing to loadavg */
 
 		err = vhost_attach_cgroups(dev);
 		if (err)
@@ -616,10 +717,7 @@ long vhost_dev_set_owner(struct vhost_dev *dev)
 
 	return 0;
 err_cgroup:
-	if (dev->worker) {
-		kthread_stop(dev->worker);
-		dev->worker = NULL;
-	}
+	vhost_workers_free(dev);
 err_worker:
 	vhost_detach_mm(dev);
 	dev->kcov_handle = 0;
@@ -712,10 +810,8 @@ void vhost_dev_cleanup(struct vhost_dev *dev)
 	dev->iotlb = NULL;
 	vhost_clear_msg(dev);
 	wake_up_interruptible_poll(&dev->wait, EPOLLIN | EPOLLRDNORM);
-	WARN_ON(!llist_empty(&dev->work_list));
-	if (dev->worker) {
-		kthread_stop(dev->worker);
-		dev->worker = NULL;
+	if (dev->workers) {
+		vhost_workers_free(dev);
 		dev->kcov_handle = 0;
 	}
 	vhost_detach_mm(dev);
@@ -1275,7 +1371,8 @@ ssize_t vhost_chr_read_iter(struct vhost_dev *dev, struct iov_iter *to,
 }
 EXPORT_SYMBOL_GPL(vhost_chr_read_iter);
 
-static int vhost_iotlb_miss(struct vhost_virtqueue *vq, u64 iova, int access)
+static int vhost_iotlb_miss(struct vhost_virtqueue *vq, u64 iova, u64 size,
+			    int access)
 {
 	struct vhost_dev *dev = vq->dev;
 	struct vhost_msg_node *node;
@@ -1295,6 +1392,7 @@ static int vhost_iotlb_miss(struct vhost_virtqueue *vq, u64 iova, int access)
 
 	msg->type = VHOST_IOTLB_MISS;
 	msg->iova = iova;
+	msg->size = size;
 	msg->perm = access;
 
 	vhost_enqueue_msg(dev, &dev->read_list, node);
@@ -1342,7 +1440,7 @@ static bool iotlb_access_ok(struct vhost_virtqueue *vq,
 	while (len > s) {
 		map = vhost_iotlb_itree_first(umem, addr, last);
 		if (map == NULL || map->start > addr) {
-			vhost_iotlb_miss(vq, addr, access);
+			vhost_iotlb_miss(vq, addr, len - s, access);
 			return false;
 		} else if (!(map->perm & access)) {
 			/* Report the possible access violation by
@@ -2041,6 +2139,34 @@ int vhost_vq_init_access(struct vhost_virtqueue *vq)
 }
 EXPORT_SYMBOL_GPL(vhost_vq_init_access);
 
+/*
+ * Look up the map containing @addr.  Translations from the device IOTLB
+ * are cached per virtqueue, so that descriptors hitting the same guest
+ * pages skip the interval tree walk.  The cache holds map pointers and is
+ * cleared, like meta_iotlb, whenever the device IOTLB is modified.
+ */
+static const struct vhost_iotlb_map *
+vhost_vq_iotlb_lookup(struct vhost_virtqueue *vq, struct vhost_iotlb *umem,
+		      u64 addr, u64 last)
+{
+	const struct vhost_iotlb_map *map;
+	unsigned int slot;
+
+	if (umem != vq->dev->iotlb)
+		return vhost_iotlb_itree_first(umem, addr, last);
+
+	slot = (addr >> PAGE_SHIFT) & (VHOST_IOTLB_CACHE_SIZE - 1);
+	map = vq->iotlb_cache[slot];
+	if (map && map->start <= addr && map->last >= addr)
+		return map;
+
+	map = vhost_iotlb_itree_first(umem, addr, last);
+	if (map && map->start <= addr)
+		vq->iotlb_cache[slot] = map;
+
+	return map;
+}
+
 static int translate_desc(struct vhost_virtqueue *vq, u64 addr, u32 len,
 			  struct iovec iov[], int iov_size, int access)
 {
@@ -2058,7 +2184,7 @@ static int translate_desc(struct vhost_virtqueue *vq, u64 addr, u32 len,
 			break;
 		}
 
-		map = vhost_iotlb_itree_first(umem, addr, addr + len - 1);
+		map = vhost_vq_iotlb_lookup(vq, umem, addr, addr + len - 1);
 		if (map == NULL || map->start > addr) {
 			if (umem != dev->iotlb) {
 				ret = -EFAULT;
@@ -2081,8 +2207,9 @@ static int translate_desc(struct vhost_virtqueue *vq, u64 addr, u32 len,
 		++ret;
 	}
 
+	/* Report the rest of the buffer, so it can be mapped in one go. */
 	if (ret == -EAGAIN)
-		vhost_iotlb_miss(vq, addr, access);
+		vhost_iotlb_miss(vq, addr, (u64)len - s, access);
 	return ret;
 }
 
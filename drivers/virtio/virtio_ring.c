@@ -69,6 +69,7 @@
 struct vring_desc_state_split {
 	void *data;			/* Data for callback. */
 	struct vring_desc *indir_desc;	/* Indirect descriptor, if any. */
+	u32 in_len;			/* Device writable length. */
 };
 
 struct vring_desc_state_packed {
@@ -106,6 +107,9 @@ struct vring_virtqueue {
 	/* Host publishes avail event idx */
 	bool event;
 
+	/* Host uses buffers in the order they were made available */
+	bool in_order;
+
 	/* Head of free buffer list. */
 	unsigned int free_head;
 	/* Number we've added since last sync. */
@@ -132,6 +136,20 @@ struct vring_virtqueue {
 			 */
 			u16 avail_idx_shadow;
 
+			/*
+			 * Head of the oldest buffer not yet returned to
+			 * the driver, only maintained for in-order rings.
+			 */
+			u16 next_used_head;
+
+			/*
+			 * In-order rings only: the used entry that ends the
+			 * batch currently being retired, if any.
+			 */
+			bool batch_pending;
+			u16 batch_last_id;
+			u32 batch_last_len;
+
 			/* Per-descriptor state. */
 			struct vring_desc_state_split *desc_state;
 			struct vring_desc_extra *desc_extra;
@@ -488,6 +506,7 @@ static inline int virtqueue_add_split(struct virtqueue *_vq,
 	struct scatterlist *sg;
 	struct vring_desc *desc;
 	unsigned int i, n, avail, descs_used, prev, err_idx;
+	u32 in_len = 0;
 	int head;
 	bool indirect;
 
@@ -571,6 +590,7 @@ static inline int virtqueue_add_split(struct virtqueue *_vq,
 						     VRING_DESC_F_NEXT |
 						     VRING_DESC_F_WRITE,
 						     indirect);
+			in_len += sg->length;
 		}
 	}
 	/* Last one doesn't continue. */
@@ -605,6 +625,7 @@ static inline int virtqueue_add_split(struct virtqueue *_vq,
 
 	/* Store token and indirect buffer state. */
 	vq->split.desc_state[head].data = data;
+	vq->split.desc_state[head].in_len = in_len;
 	if (indirect)
 		vq->split.desc_state[head].indir_desc = desc;
 	else
@@ -708,8 +729,19 @@ static void detach_buf_split(struct vring_virtqueue *vq, unsigned int head,
 	}
 
 	vring_unmap_one_split(vq, i);
-	vq->split.desc_extra[i].next = vq->free_head;
-	vq->free_head = head;
+
+	/*
+	 * In-order rings hand out descriptors sequentially around the ring
+	 * and get them back in the same order, so the free list never needs
+	 * relinking: the chain simply rejoins the free space behind the
+	 * descriptors still in flight.
+	 */
+	if (vq->in_order) {
+		vq->split.next_used_head = vq->split.desc_extra[i].next;
+	} else {
+		vq->split.desc_extra[i].next = vq->free_head;
+		vq->free_head = head;
+	}
 
 	/* Plus final descriptor */
 	vq->vq.num_free++;
@@ -770,16 +802,46 @@ static void *virtqueue_get_buf_ctx_split(struct virtqueue *_vq,
 	/* Only get used array entries after they have been exposed by host. */
 	virtio_rmb(vq->weak_barriers);
 
-	last_used = (vq->last_used_idx & (vq->split.vring.num - 1));
-	i = virtio32_to_cpu(_vq->vdev,
-			vq->split.vring.used->ring[last_used].id);
-	*len = virtio32_to_cpu(_vq->vdev,
-			vq->split.vring.used->ring[last_used].len);
+	if (vq->split.batch_pending) {
+		/* The used entry of this batch has been read already */
+		i = vq->split.next_used_head;
+		if (i == vq->split.batch_last_id) {
+			*len = vq->split.batch_last_len;
+			vq->split.batch_pending = false;
+		} else {
+			*len = vq->split.desc_state[i].in_len;
+		}
+	} else {
+		last_used = (vq->last_used_idx & (vq->split.vring.num - 1));
+		i = virtio32_to_cpu(_vq->vdev,
+				vq->split.vring.used->ring[last_used].id);
+		*len = virtio32_to_cpu(_vq->vdev,
+				vq->split.vring.used->ring[last_used].len);
+
+		if (unlikely(i >= vq->split.vring.num)) {
+			BAD_RING(vq, "id %u out of range\n", i);
+			return NULL;
+		}
 
-	if (unlikely(i >= vq->split.vring.num)) {
-		BAD_RING(vq, "id %u out of range\n", i);
-		return NULL;
+		/*
+		 * An in-order device may write a single used entry for the
+		 * last buffer of a batch and advance used->idx by the size of
+		 * the batch.  Every buffer made available before it has been
+		 * used too, so retire those one per call, reporting their
+		 * full device writable length, and remember the used entry
+		 * until its own buffer comes up.  last_used_idx advances once
+		 * per buffer, and so catches up with used->idx at the end of
+		 * the batch.
+		 */
+		if (vq->in_order && i != vq->split.next_used_head) {
+			vq->split.batch_last_id = i;
+			vq->split.batch_last_len = *len;
+			vq->split.batch_pending = true;
+			i = vq->split.next_used_head;
+			*len = vq->split.desc_state[i].in_len;
+		}
 	}
+
 	if (unlikely(!vq->split.desc_state[i].data)) {
 		BAD_RING(vq, "id %u is not a head!\n", i);
 		return NULL;
@@ -910,6 +972,10 @@ static void *virtqueue_detach_unused_buf_split(struct virtqueue *_vq)
 	}
 	/* That should have freed everything. */
 	BUG_ON(vq->vq.num_free != vq->split.vring.num);
+	if (vq->in_order) {
+		vq->split.next_used_head = vq->free_head;
+		vq->split.batch_pending = false;
+	}
 
 	END_USE(vq);
 	return NULL;
@@ -1721,6 +1787,7 @@ static struct virtqueue *vring_create_virtqueue_packed(
 	vq->indirect = virtio_has_feature(vdev, VIRTIO_RING_F_INDIRECT_DESC) &&
 		!context;
 	vq->event = virtio_has_feature(vdev, VIRTIO_RING_F_EVENT_IDX);
+	vq->in_order = false;
 
 	if (virtio_has_feature(vdev, VIRTIO_F_ORDER_PLATFORM))
 		vq->weak_barriers = false;
@@ -2209,6 +2276,7 @@ struct virtqueue *__vring_new_virtqueue(unsigned int index,
 	vq->indirect = virtio_has_feature(vdev, VIRTIO_RING_F_INDIRECT_DESC) &&
 		!context;
 	vq->event = virtio_has_feature(vdev, VIRTIO_RING_F_EVENT_IDX);
+	vq->in_order = virtio_has_feature(vdev, VIRTIO_F_IN_ORDER);
 
 	if (virtio_has_feature(vdev, VIRTIO_F_ORDER_PLATFORM))
 		vq->weak_barriers = false;
@@ -2239,6 +2307,8 @@ struct virtqueue *__vring_new_virtqueue(unsigned int index,
 
 	/* Put everything in free lists. */
 	vq->free_head = 0;
+	vq->split.next_used_head = 0;
+	vq->split.batch_pending = false;
 	memset(vq->split.desc_state, 0, vring.num *
 			sizeof(struct vring_desc_state_split));
 
@@ -2363,11 +2433,17 @@ void vring_transport_features(struct virtio_device *vdev)
 			break;
 		case VIRTIO_F_ORDER_PLATFORM:
 			break;
+		case VIRTIO_F_IN_ORDER:
+			break;
 		default:
 			/* We don't understand this bit. */
 			__virtio_clear_bit(vdev, i);
 		}
 	}
+
+	/* In-order completion is only implemented for the split ring. */
+	if (__virtio_test_bit(vdev, VIRTIO_F_RING_PACKED))
+		__virtio_clear_bit(vdev, VIRTIO_F_IN_ORDER);
 }
 EXPORT_SYMBOL_GPL(vring_transport_features);
 
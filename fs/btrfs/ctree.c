@@ -1241,6 +1241,7 @@ static void reada_for_search(struct btrfs_fs_info *fs_info,
 	u32 nr;
 	u32 blocksize;
 	u32 nscan = 0;
+	bool any_distance;
 
 	if (level != 1 && path->reada != READA_FORWARD_ALWAYS)
 		return;
@@ -1264,6 +1265,18 @@ static void reada_for_search(struct btrfs_fs_info *fs_info,
 		nread_max = SZ_64K;
 	}
 
+	/*
+	 * The 64K distance filter only makes sense when seeks are expensive.
+	 * On non-rotational devices forward scans (readdir, range lookups)
+	 * are better served by pulling in the sibling leaves as one batch,
+	 * wherever they happen to live on disk.
+	 */
+	any_distance = path->reada == READA_FORWARD_ALWAYS ||
+		       (path->reada == READA_FORWARD &&
+			!fs_info->fs_devices->rotating);
+	if (any_distance && path->reada == READA_FORWARD)
+		nread_max = SZ_128K;
+
 	search = btrfs_node_blockptr(node, slot);
 	blocksize = fs_info->nodesize;
 	if (path->reada != READA_FORWARD_ALWAYS) {
@@ -1298,7 +1311,7 @@ static void reada_for_search(struct btrfs_fs_info *fs_info,
 				break;
 		}
 		search = btrfs_node_blockptr(node, nr);
-		if (path->reada == READA_FORWARD_ALWAYS ||
+		if (any_distance ||
 		    (search <= target && target - search <= 65536) ||
 		    (search > target && search - target <= 65536)) {
 			btrfs_readahead_node_child(node, nr);
@@ -1830,6 +1843,118 @@ static int search_leaf(struct btrfs_trans_handle *trans,
 	return ret;
 }
 
+/*
+ * Try to find @key in @root without taking any read locks on the nodes above
+ * the leaf.
+ *
+ * Every tree block carries a sequence count that is bumped when its write lock
+ * is taken and released, so a reader can sample the count, read the node and
+ * then check the count is unchanged, much like a seqlock.  We walk down from
+ * the root that way using only blocks that are already cached and up to date,
+ * read lock the leaf, and then re-validate every node on the way down.  If none
+ * of them changed and the root is still the same, the leaf we locked is the one
+ * a locked walk would have found.
+ *
+ * Only plain read-only searches are handled here.  Anything that would need IO,
+ * hits a node that is write locked or changes under us returns -EAGAIN and the
+ * caller falls back to the regular locked search.  On success the path looks
+ * like the result of a locked search with upper levels unlocked: references on
+ * every level and only the leaf read locked.
+ */
+static int search_slot_lockless(struct btrfs_root *root,
+				const struct btrfs_key *key,
+				struct btrfs_path *p)
+{
+	struct btrfs_fs_info *fs_info = root->fs_info;
+	unsigned int seq[BTRFS_MAX_LEVEL];
+	struct extent_buffer *b;
+	int root_level;
+	int level;
+	int ret;
+
+	b = btrfs_root_node(root);
+	root_level = btrfs_header_level(b);
+	if (root_level == 0 || root_level >= BTRFS_MAX_LEVEL) {
+		free_extent_buffer(b);
+		return -EAGAIN;
+	}
+
+	level = root_level;
+	while (level > 0) {
+		struct extent_buffer *child;
+		u32 nritems;
+		u64 blocknr;
+		u64 gen;
+		int slot;
+
+		seq[level] = raw_read_seqcount(&b->write_seq);
+		if (seq[level] & 1)
+			goto fail;
+		if (!extent_buffer_uptodate(b) ||
+		    btrfs_header_level(b) != level)
+			goto fail;
+		nritems = btrfs_header_nritems(b);
+		if (nritems == 0 || nritems > BTRFS_NODEPTRS_PER_BLOCK(fs_info))
+			goto fail;
+
+		ret = btrfs_bin_search(b, key, &slot);
+		if (ret < 0)
+			goto fail;
+		if (ret && slot > 0)
+			slot--;
+		blocknr = btrfs_node_blockptr(b, slot);
+		gen = btrfs_node_ptr_generation(b, slot);
+		if (read_seqcount_retry(&b->write_seq, seq[level]))
+			goto fail;
+
+		p->nodes[level] = b;
+		p->slots[level] = slot;
+		b = NULL;
+
+		child = find_extent_buffer(fs_info, blocknr);
+		if (!child)
+			goto fail;
+		if (btrfs_buffer_uptodate(child, gen, 1) <= 0 ||
+		    btrfs_header_level(child) != level - 1) {
+			free_extent_buffer(child);
+			goto fail;
+		}
+		b = child;
+		level--;
+	}
+
+	btrfs_tree_read_lock(b);
+	p->nodes[0] = b;
+	p->locks[0] = BTRFS_READ_LOCK;
+	b = NULL;
+
+	/*
+	 * With the leaf locked nobody can change it, but it may have been
+	 * COWed or freed before we got the lock.  That always goes through a
+	 * write lock on its parent (or a root switch), so checking the nodes
+	 * above it is enough.
+	 */
+	for (level = 1; level <= root_level; level++) {
+		if (read_seqcount_retry(&p->nodes[level]->write_seq, seq[level]))
+			goto fail;
+	}
+	if (rcu_access_pointer(root->node) != p->nodes[root_level])
+		goto fail;
+
+	if (btrfs_header_generation(p->nodes[0]) !=
+	    btrfs_node_ptr_generation(p->nodes[1], p->slots[1]))
+		goto fail;
+
+	ret = search_for_key_slot(p->nodes[0], 0, key, -1, &p->slots[0]);
+	if (ret < 0)
+		goto fail;
+	return ret;
+fail:
+	free_extent_buffer(b);
+	btrfs_release_path(p);
+	return -EAGAIN;
+}
+
 /*
  * btrfs_search_slot - look for a key in a tree and perform necessary
  * modifications to preserve tree invariants.
@@ -1907,6 +2032,13 @@ int btrfs_search_slot(struct btrfs_trans_handle *trans, struct btrfs_root *root,
 
 	min_write_lock_level = write_lock_level;
 
+	if (!cow && !p->keep_locks && !p->lowest_level && !p->skip_locking &&
+	    !p->search_commit_root) {
+		ret = search_slot_lockless(root, key, p);
+		if (ret != -EAGAIN)
+			return ret;
+	}
+
 	if (p->need_commit_sem) {
 		ASSERT(p->search_commit_root);
 		down_read(&fs_info->commit_root_sem);
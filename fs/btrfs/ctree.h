@@ -827,6 +827,8 @@ struct btrfs_fs_info {
 	struct btrfs_workqueue *endio_write_workers;
 	struct btrfs_workqueue *endio_freespace_worker;
 	struct btrfs_workqueue *caching_workers;
+	struct btrfs_workqueue *csum_workers;
+	struct btrfs_workqueue *delayed_ref_workers;
 
 	/*
 	 * fixup workers take dirty pages that didn't properly go through
@@ -2720,6 +2722,7 @@ int btrfs_add_excluded_extent(struct btrfs_fs_info *fs_info,
 void btrfs_free_excluded_extents(struct btrfs_block_group *cache);
 int btrfs_run_delayed_refs(struct btrfs_trans_handle *trans,
 			   unsigned long count);
+int btrfs_run_delayed_refs_parallel(struct btrfs_trans_handle *trans);
 void btrfs_cleanup_ref_head_accounting(struct btrfs_fs_info *fs_info,
 				  struct btrfs_delayed_ref_root *delayed_refs,
 				  struct btrfs_delayed_ref_head *head);
@@ -543,43 +543,61 @@ int btrfs_check_delayed_seq(struct btrfs_fs_info *fs_info, u64 seq)
 	return ret;
 }
 
-struct btrfs_delayed_ref_head *btrfs_select_ref_head(
-		struct btrfs_delayed_ref_root *delayed_refs)
+/*
+ * Pick the next head that nobody is processing yet, starting at *@cursor and
+ * wrapping around once inside [@start, @end).  This lets several tasks run
+ * delayed refs for disjoint bytenr ranges at the same time, each with its own
+ * cursor, so they end up touching different parts of the extent tree.
+ */
+struct btrfs_delayed_ref_head *btrfs_select_ref_head_range(
+		struct btrfs_delayed_ref_root *delayed_refs, u64 *cursor,
+		u64 start, u64 end)
 {
 	struct btrfs_delayed_ref_head *head;
 
+	lockdep_assert_held(&delayed_refs->lock);
 again:
-	head = find_ref_head(delayed_refs, delayed_refs->run_delayed_start,
-			     true);
-	if (!head && delayed_refs->run_delayed_start != 0) {
-		delayed_refs->run_delayed_start = 0;
-		head = find_first_ref_head(delayed_refs);
+	head = find_ref_head(delayed_refs, *cursor, true);
+	if ((!head || head->bytenr >= end) && *cursor != start) {
+		*cursor = start;
+		if (start == 0)
+			head = find_first_ref_head(delayed_refs);
+		else
+			head = find_ref_head(delayed_refs, start, true);
 	}
-	if (!head)
+	if (!head || head->bytenr >= end)
 		return NULL;
 
 	while (head->processing) {
 		struct rb_node *node;
 
 		node = rb_next(&head->href_node);
-		if (!node) {
-			if (delayed_refs->run_delayed_start == 0)
+		if (node)
+			head = rb_entry(node, struct btrfs_delayed_ref_head,
+					href_node);
+		if (!node || head->bytenr >= end) {
+			if (*cursor == start)
 				return NULL;
-			delayed_refs->run_delayed_start = 0;
+			*cursor = start;
 			goto again;
 		}
-		head = rb_entry(node, struct btrfs_delayed_ref_head,
-				href_node);
 	}
 
 	head->processing = 1;
 	WARN_ON(delayed_refs->num_heads_ready == 0);
 	delayed_refs->num_heads_ready--;
-	delayed_refs->run_delayed_start = head->bytenr +
-		head->num_bytes;
+	*cursor = head->bytenr + head->num_bytes;
 	return head;
 }
 
+struct btrfs_delayed_ref_head *btrfs_select_ref_head(
+		struct btrfs_delayed_ref_root *delayed_refs)
+{
+	return btrfs_select_ref_head_range(delayed_refs,
+					   &delayed_refs->run_delayed_start,
+					   0, (u64)-1);
+}
+
 void btrfs_delete_ref_head(struct btrfs_delayed_ref_root *delayed_refs,
 			   struct btrfs_delayed_ref_head *head)
 {
@@ -376,6 +376,9 @@ void btrfs_delete_ref_head(struct btrfs_delayed_ref_root *delayed_refs,
 
 struct btrfs_delayed_ref_head *btrfs_select_ref_head(
 		struct btrfs_delayed_ref_root *delayed_refs);
+struct btrfs_delayed_ref_head *btrfs_select_ref_head_range(
+		struct btrfs_delayed_ref_root *delayed_refs, u64 *cursor,
+		u64 start, u64 end);
 
 int btrfs_check_delayed_seq(struct btrfs_fs_info *fs_info, u64 seq);
 
@@ -1867,8 +1867,25 @@ static int cleanup_ref_head(struct btrfs_trans_handle *trans,
 	return ret;
 }
 
+/*
+ * A bytenr range of the delayed ref heads, run by one task during a parallel
+ * delayed ref run.  See btrfs_run_delayed_refs_parallel().
+ */
+struct delayed_ref_shard {
+	struct btrfs_work work;
+	struct btrfs_fs_info *fs_info;
+	struct btrfs_transaction *transaction;
+	unsigned long count;
+	u64 start;
+	u64 end;
+	u64 cursor;
+	int error;
+	struct completion done;
+};
+
 static struct btrfs_delayed_ref_head *btrfs_obtain_ref_head(
-					struct btrfs_trans_handle *trans)
+					struct btrfs_trans_handle *trans,
+					struct delayed_ref_shard *shard)
 {
 	struct btrfs_delayed_ref_root *delayed_refs =
 		&trans->transaction->delayed_refs;
@@ -1876,7 +1893,11 @@ static struct btrfs_delayed_ref_head *btrfs_obtain_ref_head(
 	int ret;
 
 	spin_lock(&delayed_refs->lock);
-	head = btrfs_select_ref_head(delayed_refs);
+	if (shard)
+		head = btrfs_select_ref_head_range(delayed_refs, &shard->cursor,
+						   shard->start, shard->end);
+	else
+		head = btrfs_select_ref_head(delayed_refs);
 	if (!head) {
 		spin_unlock(&delayed_refs->lock);
 		return head;
@@ -1985,7 +2006,8 @@ static int btrfs_run_delayed_refs_for_head(struct btrfs_trans_handle *trans,
  * Returns -ENOMEM or -EIO on failure and will abort the transaction.
  */
 static noinline int __btrfs_run_delayed_refs(struct btrfs_trans_handle *trans,
-					     unsigned long nr)
+					     unsigned long nr,
+					     struct delayed_ref_shard *shard)
 {
 	struct btrfs_fs_info *fs_info = trans->fs_info;
 	struct btrfs_delayed_ref_root *delayed_refs;
@@ -1998,7 +2020,7 @@ static noinline int __btrfs_run_delayed_refs(struct btrfs_trans_handle *trans,
 	delayed_refs = &trans->transaction->delayed_refs;
 	do {
 		if (!locked_ref) {
-			locked_ref = btrfs_obtain_ref_head(trans);
+			locked_ref = btrfs_obtain_ref_head(trans, shard);
 			if (IS_ERR_OR_NULL(locked_ref)) {
 				if (PTR_ERR(locked_ref) == -EAGAIN) {
 					continue;
@@ -2154,7 +2176,7 @@ int btrfs_run_delayed_refs(struct btrfs_trans_handle *trans,
 #ifdef SCRAMBLE_DELAYED_REFS
 	delayed_refs->run_delayed_start = find_middle(&delayed_refs->root);
 #endif
-	ret = __btrfs_run_delayed_refs(trans, count);
+	ret = __btrfs_run_delayed_refs(trans, count, NULL);
 	if (ret < 0) {
 		btrfs_abort_transaction(trans, ret);
 		return ret;
@@ -2186,6 +2208,142 @@ int btrfs_run_delayed_refs(struct btrfs_trans_handle *trans,
 	return 0;
 }
 
+/*
+ * Below this many ready heads per task a parallel run is not worth the cost of
+ * joining the transaction from the workers.
+ */
+#define BTRFS_DELAYED_REF_SHARD_HEADS	4096
+
+static void run_delayed_ref_shard(struct delayed_ref_shard *shard)
+{
+	struct btrfs_fs_info *fs_info = shard->fs_info;
+	struct btrfs_trans_handle *trans;
+	int ret;
+
+	/*
+	 * The committer holds a handle on the transaction and is waiting for
+	 * us, so join it without sb_start_intwrite(), like the space cache
+	 * writeout does, to not deadlock against a freeze.
+	 */
+	trans = btrfs_join_transaction_spacecache(
+				btrfs_extent_root(fs_info, shard->start));
+	if (IS_ERR(trans)) {
+		shard->error = PTR_ERR(trans);
+		return;
+	}
+
+	if (trans->transaction == shard->transaction) {
+		ret = __btrfs_run_delayed_refs(trans, shard->count, shard);
+		if (ret < 0) {
+			btrfs_abort_transaction(trans, ret);
+			shard->error = ret;
+		}
+	}
+
+	ret = btrfs_end_transaction(trans);
+	if (ret && !shard->error)
+		shard->error = ret;
+}
+
+static void delayed_ref_shard_work(struct btrfs_work *work)
+{
+	struct delayed_ref_shard *shard;
+
+	shard = container_of(work, struct delayed_ref_shard, work);
+	run_delayed_ref_shard(shard);
+	complete(&shard->done);
+}
+
+/*
+ * Run the delayed refs that are ready, like btrfs_run_delayed_refs(trans, 0),
+ * but split the heads by bytenr into ranges and run them from several tasks
+ * at once.
+ *
+ * Each range maps to a different part of the extent tree, so the tasks mostly
+ * lock and modify different leaves and can make progress concurrently, which
+ * shortens the part of the transaction commit where writers have to wait for
+ * the delayed refs to be run.  The calling task runs the last range itself.
+ *
+ * Must be called with a transaction handle that is not yet committing, since
+ * the workers need to join the same transaction.
+ */
+int btrfs_run_delayed_refs_parallel(struct btrfs_trans_handle *trans)
+{
+	struct btrfs_fs_info *fs_info = trans->fs_info;
+	struct btrfs_delayed_ref_root *delayed_refs;
+	struct btrfs_delayed_ref_head *head;
+	struct delayed_ref_shard *shards;
+	struct rb_node *node;
+	unsigned long count;
+	u64 first;
+	u64 last;
+	u64 span;
+	int nr_shards;
+	int ret = 0;
+	int i;
+
+	if (TRANS_ABORTED(trans))
+		return 0;
+
+	delayed_refs = &trans->transaction->delayed_refs;
+
+	spin_lock(&delayed_refs->lock);
+	count = delayed_refs->num_heads_ready;
+	node = rb_first_cached(&delayed_refs->href_root);
+	if (!node) {
+		spin_unlock(&delayed_refs->lock);
+		return 0;
+	}
+	head = rb_entry(node, struct btrfs_delayed_ref_head, href_node);
+	first = head->bytenr;
+	node = rb_last(&delayed_refs->href_root.rb_root);
+	head = rb_entry(node, struct btrfs_delayed_ref_head, href_node);
+	last = head->bytenr;
+	spin_unlock(&delayed_refs->lock);
+
+	nr_shards = min_t(unsigned long, fs_info->thread_pool_size,
+			  count / BTRFS_DELAYED_REF_SHARD_HEADS);
+	if (nr_shards < 2 || last == first ||
+	    test_bit(BTRFS_FS_CREATING_FREE_SPACE_TREE, &fs_info->flags))
+		return btrfs_run_delayed_refs(trans, 0);
+
+	shards = kcalloc(nr_shards, sizeof(*shards), GFP_NOFS);
+	if (!shards)
+		return btrfs_run_delayed_refs(trans, 0);
+
+	span = div_u64(last - first, nr_shards) + 1;
+	for (i = 0; i < nr_shards; i++) {
+		struct delayed_ref_shard *shard = &shards[i];
+
+		shard->fs_info = fs_info;
+		shard->transaction = trans->transaction;
+		shard->count = count;
+		shard->start = first + i * span;
+		shard->end = (i == nr_shards - 1) ? (u64)-1 :
+			     shard->start + span;
+		shard->cursor = shard->start;
+		init_completion(&shard->done);
+		if (i == nr_shards - 1)
+			break;
+		btrfs_init_work(&shard->work, delayed_ref_shard_work,
+				NULL, NULL);
+		btrfs_queue_work(fs_info->delayed_ref_workers, &shard->work);
+	}
+
+	ret = __btrfs_run_delayed_refs(trans, count, &shards[nr_shards - 1]);
+
+	for (i = 0; i < nr_shards - 1; i++) {
+		wait_for_completion(&shards[i].done);
+		if (shards[i].error && !ret)
+			ret = shards[i].error;
+	}
+	kfree(shards);
+
+	if (ret < 0)
+		btrfs_abort_transaction(trans, ret);
+	return ret;
+}
+
 int btrfs_set_disk_extent_flags(struct btrfs_trans_handle *trans,
 				struct extent_buffer *eb, u64 flags,
 				int level, int is_data)
@@ -5,6 +5,7 @@
 
 #include <linux/rbtree.h>
 #include <linux/refcount.h>
+#include <linux/seqlock.h>
 #include <linux/fiemap.h>
 #include <linux/btrfs_tree.h>
 #include "ulist.h"
@@ -93,6 +94,11 @@ struct extent_buffer {
 	s8 log_index;
 
 	struct rw_semaphore lock;
+	/*
+	 * Bumped around every write lock hold, lets btrfs_search_slot() walk
+	 * the tree without taking read locks and validate afterwards.
+	 */
+	seqcount_t write_seq;
 
 	struct page *pages[INLINE_EXTENT_BUFFER_PAGES];
 	struct list_head release_list;
@@ -620,6 +620,144 @@ int btrfs_lookup_csums_range(struct btrfs_root *root, u64 start, u64 end,
 	return ret;
 }
 
+/*
+ * Bios at least BTRFS_CSUM_PARALLEL_MIN large have their checksums computed by
+ * the csum workers in parallel, in chunks of at least BTRFS_CSUM_CHUNK_SIZE.
+ */
+#define BTRFS_CSUM_PARALLEL_MIN		SZ_512K
+#define BTRFS_CSUM_CHUNK_SIZE		SZ_128K
+
+struct btrfs_csum_chunk {
+	struct btrfs_work work;
+	struct btrfs_fs_info *fs_info;
+	struct bio *bio;
+	u32 first_sector;
+	u32 nr_sectors;
+	u8 *csums;
+	atomic_t *pending;
+	struct completion *done;
+};
+
+/*
+ * Calculate the checksums of @nr_sectors sectors of @bio, starting at
+ * @first_sector, into the flat array @csums which covers the whole bio.
+ */
+static void csum_bio_sectors(struct btrfs_fs_info *fs_info, struct bio *bio,
+			     u32 first_sector, u32 nr_sectors, u8 *csums)
+{
+	SHASH_DESC_ON_STACK(shash, fs_info->csum_shash);
+	const u32 sectorsize_bits = fs_info->sectorsize_bits;
+	const u32 csum_size = fs_info->csum_size;
+	const u32 last_sector = first_sector + nr_sectors;
+	struct bvec_iter iter;
+	struct bio_vec bvec;
+	u32 sector = 0;
+
+	shash->tfm = fs_info->csum_shash;
+
+	bio_for_each_segment(bvec, bio, iter) {
+		const u32 bvec_sectors = bvec.bv_len >> sectorsize_bits;
+		char *data;
+		u32 i;
+
+		if (sector + bvec_sectors <= first_sector) {
+			sector += bvec_sectors;
+			continue;
+		}
+
+		data = bvec_kmap_local(&bvec);
+		for (i = 0; i < bvec_sectors && sector < last_sector;
+		     i++, sector++) {
+			if (sector < first_sector)
+				continue;
+			crypto_shash_digest(shash,
+					    data + (i << sectorsize_bits),
+					    fs_info->sectorsize,
+					    csums + sector * csum_size);
+		}
+		kunmap_local(data);
+
+		if (sector >= last_sector)
+			break;
+	}
+}
+
+static void csum_chunk_work(struct btrfs_work *work)
+{
+	struct btrfs_csum_chunk *chunk;
+
+	chunk = container_of(work, struct btrfs_csum_chunk, work);
+	csum_bio_sectors(chunk->fs_info, chunk->bio, chunk->first_sector,
+			 chunk->nr_sectors, chunk->csums);
+	if (atomic_dec_and_test(chunk->pending))
+		complete(chunk->done);
+}
+
+/*
+ * Calculate the checksums of all sectors of a large bio into one flat array,
+ * splitting the work between the calling task and the csum workers, so a single
+ * large writer isn't limited to the hashing throughput of one CPU.
+ *
+ * Return NULL if the bio is too small for this to pay off or we can't get the
+ * memory, in which case the caller hashes each sector itself.
+ */
+static u8 *csum_bio_parallel(struct btrfs_fs_info *fs_info, struct bio *bio)
+{
+	const u32 nr_sectors = bio->bi_iter.bi_size >> fs_info->sectorsize_bits;
+	const unsigned int nr_cpus = num_online_cpus();
+	DECLARE_COMPLETION_ONSTACK(done);
+	struct btrfs_csum_chunk *chunks;
+	unsigned int nofs_flag;
+	atomic_t pending;
+	u32 chunk_sectors;
+	u32 nr_chunks;
+	u8 *csums;
+	u32 i;
+
+	if (bio->bi_iter.bi_size < BTRFS_CSUM_PARALLEL_MIN || nr_cpus == 1)
+		return NULL;
+
+	chunk_sectors = max_t(u32,
+			      BTRFS_CSUM_CHUNK_SIZE >> fs_info->sectorsize_bits,
+			      DIV_ROUND_UP(nr_sectors, nr_cpus));
+	nr_chunks = DIV_ROUND_UP(nr_sectors, chunk_sectors);
+	if (nr_chunks < 2)
+		return NULL;
+
+	nofs_flag = memalloc_nofs_save();
+	csums = kvmalloc_array(nr_sectors, fs_info->csum_size, GFP_KERNEL);
+	chunks = kcalloc(nr_chunks, sizeof(*chunks), GFP_KERNEL);
+	memalloc_nofs_restore(nofs_flag);
+	if (!csums || !chunks) {
+		kvfree(csums);
+		kfree(chunks);
+		return NULL;
+	}
+
+	/* The first chunk is done by us, queue the others to the workers */
+	atomic_set(&pending, nr_chunks - 1);
+	for (i = 1; i < nr_chunks; i++) {
+		struct btrfs_csum_chunk *chunk = &chunks[i];
+
+		chunk->fs_info = fs_info;
+		chunk->bio = bio;
+		chunk->first_sector = i * chunk_sectors;
+		chunk->nr_sectors = min(chunk_sectors,
+					nr_sectors - chunk->first_sector);
+		chunk->csums = csums;
+		chunk->pending = &pending;
+		chunk->done = &done;
+		btrfs_init_work(&chunk->work, csum_chunk_work, NULL, NULL);
+		btrfs_queue_work(fs_info->csum_workers, &chunk->work);
+	}
+
+	csum_bio_sectors(fs_info, bio, 0, chunk_sectors, csums);
+	wait_for_completion(&done);
+	kfree(chunks);
+
+	return csums;
+}
+
 /*
  * btrfs_csum_one_bio - Calculates checksums of the data contained inside a bio
  * @inode:	 Owner of the data inside the bio
@@ -647,6 +785,8 @@ blk_status_t btrfs_csum_one_bio(struct btrfs_inode *inode, struct bio *bio,
 	int i;
 	u64 offset;
 	unsigned nofs_flag;
+	u8 *csums;
+	u32 sector_nr = 0;
 
 	nofs_flag = memalloc_nofs_save();
 	sums = kvzalloc(btrfs_ordered_sum_size(fs_info, bio->bi_iter.bi_size),
@@ -669,6 +809,12 @@ blk_status_t btrfs_csum_one_bio(struct btrfs_inode *inode, struct bio *bio,
 
 	shash->tfm = fs_info->csum_shash;
 
+	/*
+	 * For large bios the hashing is done up front in parallel and the
+	 * loop below only distributes the checksums to the ordered extents.
+	 */
+	csums = csum_bio_parallel(fs_info, bio);
+
 	bio_for_each_segment(bvec, bio, iter) {
 		if (!contig)
 			offset = page_offset(bvec.bv_page) + bvec.bv_offset;
@@ -685,6 +831,7 @@ blk_status_t btrfs_csum_one_bio(struct btrfs_inode *inode, struct bio *bio,
 				     inode->root->root_key.objectid,
 				     btrfs_ino(inode), offset);
 				kvfree(sums);
+				kvfree(csums);
 				return BLK_STS_IOERR;
 			}
 		}
@@ -719,12 +866,19 @@ blk_status_t btrfs_csum_one_bio(struct btrfs_inode *inode, struct bio *bio,
 				index = 0;
 			}
 
-			data = bvec_kmap_local(&bvec);
-			crypto_shash_digest(shash,
-					    data + (i * fs_info->sectorsize),
-					    fs_info->sectorsize,
-					    sums->sums + index);
-			kunmap_local(data);
+			if (csums) {
+				memcpy(sums->sums + index,
+				       csums + sector_nr * fs_info->csum_size,
+				       fs_info->csum_size);
+			} else {
+				data = bvec_kmap_local(&bvec);
+				crypto_shash_digest(shash,
+					data + (i * fs_info->sectorsize),
+					fs_info->sectorsize,
+					sums->sums + index);
+				kunmap_local(data);
+			}
+			sector_nr++;
 			index += fs_info->csum_size;
 			offset += fs_info->sectorsize;
 			this_sum_bytes += fs_info->sectorsize;
@@ -735,6 +889,7 @@ blk_status_t btrfs_csum_one_bio(struct btrfs_inode *inode, struct bio *bio,
 	this_sum_bytes = 0;
 	btrfs_add_ordered_sum(ordered, sums);
 	btrfs_put_ordered_extent(ordered);
+	kvfree(csums);
 	return 0;
 }
 
@@ -1391,7 +1391,8 @@ static int cow_file_range_async(struct btrfs_inode *inode,
 	struct async_chunk *async_chunk;
 	unsigned long nr_pages;
 	u64 cur_end;
-	u64 num_chunks = DIV_ROUND_UP(end - start, SZ_512K);
+	u64 chunk_size = SZ_512K;
+	u64 num_chunks;
 	int i;
 	bool should_compress;
 	unsigned nofs_flag;
@@ -1404,6 +1405,29 @@ static int cow_file_range_async(struct btrfs_inode *inode,
 		num_chunks = 1;
 		should_compress = false;
 	} else {
+		bool forced = btrfs_test_opt(fs_info, FORCE_COMPRESS) ||
+			      inode->defrag_compress;
+
+		/*
+		 * Compression happens in BTRFS_MAX_UNCOMPRESSED units anyway,
+		 * so when the range doesn't cover all the delalloc workers
+		 * with 512K chunks, use smaller ones to keep more cpus busy.
+		 * Each chunk also gets its own compressibility check.
+		 *
+		 * Chunks that don't compress are written out as uncompressed
+		 * extents of the chunk size, so only do this if the heuristic
+		 * expects the data to compress.  Unless compression is forced,
+		 * inode_need_compress() has already asked it.
+		 */
+		if (!forced ||
+		    btrfs_compress_heuristic(&inode->vfs_inode, start, end)) {
+			chunk_size = div_u64(end - start + 1,
+					     fs_info->thread_pool_size);
+			chunk_size = clamp_t(u64, round_up(chunk_size,
+						BTRFS_MAX_UNCOMPRESSED),
+					BTRFS_MAX_UNCOMPRESSED, SZ_512K);
+		}
+		num_chunks = DIV_ROUND_UP(end - start, chunk_size);
 		should_compress = true;
 	}
 
@@ -1428,7 +1452,7 @@ static int cow_file_range_async(struct btrfs_inode *inode,
 
 	for (i = 0; i < num_chunks; i++) {
 		if (should_compress)
-			cur_end = min(end, start + SZ_512K - 1);
+			cur_end = min(end, start + chunk_size - 1);
 		else
 			cur_end = end;
 
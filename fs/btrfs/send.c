@@ -76,6 +76,13 @@ struct clone_root {
 #define SEND_CTX_MAX_NAME_CACHE_SIZE 128
 #define SEND_CTX_NAME_CACHE_CLEAN_SIZE (SEND_CTX_MAX_NAME_CACHE_SIZE * 2)
 
+/*
+ * Number of data extents for which we remember the backrefs found in the clone
+ * roots, and the maximum number of such backrefs we remember per extent.
+ */
+#define SEND_CTX_MAX_BACKREF_CACHE_SIZE 128
+#define SEND_MAX_BACKREF_CACHE_REFS	256
+
 struct send_ctx {
 	struct file *send_filp;
 	loff_t send_off;
@@ -132,6 +139,17 @@ struct send_ctx {
 	struct list_head name_cache_list;
 	int name_cache_size;
 
+	/*
+	 * Backrefs of data extents already looked up by find_extent_clone(),
+	 * indexed by extent bytenr and offset, with an LRU list for eviction.
+	 * Only valid as long as no relocation happened since they were
+	 * collected, see backref_cache_reloc_trans.
+	 */
+	struct rb_root backref_cache;
+	struct list_head backref_cache_list;
+	int backref_cache_size;
+	u64 backref_cache_reloc_trans;
+
 	struct file_ra_state ra;
 
 	/*
@@ -259,6 +277,21 @@ struct orphan_dir_info {
 	u64 last_dir_index_offset;
 };
 
+struct backref_cache_ref {
+	u64 ino;
+	u64 offset;
+	u64 root;
+};
+
+struct backref_cache_entry {
+	struct rb_node rb_node;
+	struct list_head list;
+	u64 bytenr;
+	u64 extent_item_pos;
+	int num_refs;
+	struct backref_cache_ref refs[];
+};
+
 struct name_cache_entry {
 	struct list_head list;
 	/*
@@ -1209,8 +1242,141 @@ struct backref_ctx {
 
 	/* Just to check for bugs in backref resolving */
 	int found_itself;
+
+	/*
+	 * Backrefs in clone roots collected while walking the backrefs, to
+	 * be added to the backref cache once the walk is done.
+	 */
+	struct backref_cache_ref *cache_refs;
+	int cache_nr_refs;
+	int cache_max_refs;
+	bool collect_refs;
 };
 
+static struct backref_cache_entry *backref_cache_search(struct send_ctx *sctx,
+							u64 bytenr,
+							u64 extent_item_pos)
+{
+	struct rb_node *n = sctx->backref_cache.rb_node;
+	struct backref_cache_entry *entry;
+
+	while (n) {
+		entry = rb_entry(n, struct backref_cache_entry, rb_node);
+		if (bytenr < entry->bytenr)
+			n = n->rb_left;
+		else if (bytenr > entry->bytenr)
+			n = n->rb_right;
+		else if (extent_item_pos < entry->extent_item_pos)
+			n = n->rb_left;
+		else if (extent_item_pos > entry->extent_item_pos)
+			n = n->rb_right;
+		else {
+			list_move_tail(&entry->list, &sctx->backref_cache_list);
+			return entry;
+		}
+	}
+	return NULL;
+}
+
+static void backref_cache_delete(struct send_ctx *sctx,
+				 struct backref_cache_entry *entry)
+{
+	rb_erase(&entry->rb_node, &sctx->backref_cache);
+	list_del(&entry->list);
+	sctx->backref_cache_size--;
+	kfree(entry);
+}
+
+static void backref_cache_free(struct send_ctx *sctx)
+{
+	struct backref_cache_entry *entry;
+
+	while (!list_empty(&sctx->backref_cache_list)) {
+		entry = list_first_entry(&sctx->backref_cache_list,
+					 struct backref_cache_entry, list);
+		backref_cache_delete(sctx, entry);
+	}
+}
+
+/*
+ * Remember the backrefs collected in @bctx for the extent at @bytenr, so that
+ * other file extent items pointing to the same extent don't need to walk them
+ * again.  Failing to allocate just means we don't cache them.
+ */
+static void backref_cache_insert(struct send_ctx *sctx,
+				 struct backref_ctx *bctx,
+				 u64 bytenr, u64 extent_item_pos)
+{
+	struct rb_node **p = &sctx->backref_cache.rb_node;
+	struct rb_node *parent = NULL;
+	struct backref_cache_entry *entry;
+	struct backref_cache_entry *new;
+
+	new = kmalloc(struct_size(new, refs, bctx->cache_nr_refs), GFP_KERNEL);
+	if (!new)
+		return;
+	new->bytenr = bytenr;
+	new->extent_item_pos = extent_item_pos;
+	new->num_refs = bctx->cache_nr_refs;
+	memcpy(new->refs, bctx->cache_refs,
+	       bctx->cache_nr_refs * sizeof(struct backref_cache_ref));
+
+	while (*p) {
+		parent = *p;
+		entry = rb_entry(parent, struct backref_cache_entry, rb_node);
+		if (bytenr < entry->bytenr ||
+		    (bytenr == entry->bytenr &&
+		     extent_item_pos < entry->extent_item_pos)) {
+			p = &(*p)->rb_left;
+		} else if (bytenr > entry->bytenr ||
+			   extent_item_pos > entry->extent_item_pos) {
+			p = &(*p)->rb_right;
+		} else {
+			kfree(new);
+			return;
+		}
+	}
+	rb_link_node(&new->rb_node, parent, p);
+	rb_insert_color(&new->rb_node, &sctx->backref_cache);
+	list_add_tail(&new->list, &sctx->backref_cache_list);
+	sctx->backref_cache_size++;
+
+	if (sctx->backref_cache_size > SEND_CTX_MAX_BACKREF_CACHE_SIZE) {
+		entry = list_first_entry(&sctx->backref_cache_list,
+					 struct backref_cache_entry, list);
+		backref_cache_delete(sctx, entry);
+	}
+}
+
+static void backref_cache_collect(struct backref_ctx *bctx, u64 ino,
+				  u64 offset, u64 root)
+{
+	struct backref_cache_ref *ref;
+
+	if (bctx->cache_nr_refs == bctx->cache_max_refs) {
+		struct backref_cache_ref *refs;
+		int new_max = max(bctx->cache_max_refs * 2, 8);
+
+		if (new_max > SEND_MAX_BACKREF_CACHE_REFS) {
+			bctx->collect_refs = false;
+			return;
+		}
+		refs = krealloc(bctx->cache_refs, new_max * sizeof(*refs),
+				GFP_KERNEL);
+		if (!refs) {
+			bctx->collect_refs = false;
+			return;
+		}
+		bctx->cache_refs = refs;
+		bctx->cache_max_refs = new_max;
+	}
+
+	ref = &bctx->cache_refs[bctx->cache_nr_refs++];
+	ref->ino = ino;
+	ref->offset = offset;
+	ref->root = root;
+}
+
 static int __clone_root_cmp_bsearch(const void *key, const void *elt)
 {
 	u64 root = (u64)(uintptr_t)key;
@@ -1252,6 +1418,9 @@ static int __iterate_backrefs(u64 ino, u64 offset, u64 root, void *ctx_)
 	if (!found)
 		return 0;
 
+	if (bctx->collect_refs)
+		backref_cache_collect(bctx, ino, offset, root);
+
 	if (found->root == bctx->sctx->send_root &&
 	    ino == bctx->cur_objectid &&
 	    offset == bctx->cur_offset) {
@@ -1324,6 +1493,7 @@ static int find_extent_clone(struct send_ctx *sctx,
 	struct btrfs_file_extent_item *fi;
 	struct extent_buffer *eb = path->nodes[0];
 	struct backref_ctx backref_ctx = {0};
+	struct backref_cache_entry *cached;
 	struct clone_root *cur_clone_root;
 	struct btrfs_key found_key;
 	struct btrfs_path *tmp_path;
@@ -1365,7 +1535,27 @@ static int find_extent_clone(struct send_ctx *sctx,
 	}
 	logical = disk_byte + btrfs_file_extent_offset(eb, fi);
 
+	/*
+	 * The file extent items of data extents always point to the start of
+	 * the extent, so disk_byte is the key of the extent item and we can
+	 * look in the backref cache before searching the extent tree.
+	 */
+	if (compressed == BTRFS_COMPRESS_NONE)
+		extent_item_pos = logical - disk_byte;
+	else
+		extent_item_pos = 0;
+
 	down_read(&fs_info->commit_root_sem);
+	if (fs_info->last_reloc_trans > sctx->backref_cache_reloc_trans) {
+		backref_cache_free(sctx);
+		sctx->backref_cache_reloc_trans = fs_info->last_reloc_trans;
+	}
+	cached = backref_cache_search(sctx, disk_byte, extent_item_pos);
+	if (cached) {
+		up_read(&fs_info->commit_root_sem);
+		found_key.objectid = disk_byte;
+		goto setup_clone_roots;
+	}
 	ret = extent_from_logical(fs_info, disk_byte, tmp_path,
 				  &found_key, &flags);
 	up_read(&fs_info->commit_root_sem);
@@ -1392,6 +1582,7 @@ static int find_extent_clone(struct send_ctx *sctx,
 	}
 	btrfs_release_path(tmp_path);
 
+setup_clone_roots:
 	/*
 	 * Setup the clone roots.
 	 */
@@ -1418,21 +1609,27 @@ static int find_extent_clone(struct send_ctx *sctx,
 		backref_ctx.extent_len = ino_size - data_offset;
 
 	/*
-	 * Now collect all backrefs.
+	 * Now collect all backrefs, or replay the ones we found last time we
+	 * looked at this extent.
 	 */
-	if (compressed == BTRFS_COMPRESS_NONE)
-		extent_item_pos = logical - found_key.objectid;
-	else
-		extent_item_pos = 0;
-	ret = iterate_extent_inodes(fs_info, found_key.objectid,
-				    extent_item_pos, 1, __iterate_backrefs,
-				    &backref_ctx, false);
-
-	if (ret < 0)
-		goto out;
+	if (cached) {
+		for (i = 0; i < cached->num_refs; i++)
+			__iterate_backrefs(cached->refs[i].ino,
+					   cached->refs[i].offset,
+					   cached->refs[i].root, &backref_ctx);
+	} else {
+		backref_ctx.collect_refs = true;
+		ret = iterate_extent_inodes(fs_info, found_key.objectid,
+					    extent_item_pos, 1,
+					    __iterate_backrefs,
+					    &backref_ctx, false);
+		if (ret < 0)
+			goto out;
+	}
 
 	down_read(&fs_info->commit_root_sem);
-	if (fs_info->last_reloc_trans > sctx->last_reloc_trans) {
+	if (fs_info->last_reloc_trans > sctx->last_reloc_trans ||
+	    fs_info->last_reloc_trans > sctx->backref_cache_reloc_trans) {
 		/*
 		 * A transaction commit for a transaction in which block group
 		 * relocation was done just happened.
@@ -1451,6 +1648,10 @@ static int find_extent_clone(struct send_ctx *sctx,
 	}
 	up_read(&fs_info->commit_root_sem);
 
+	if (backref_ctx.collect_refs)
+		backref_cache_insert(sctx, &backref_ctx, found_key.objectid,
+				     extent_item_pos);
+
 	if (!backref_ctx.found_itself) {
 		/* found a bug in backref code? */
 		ret = -EIO;
@@ -1487,6 +1688,7 @@ static int find_extent_clone(struct send_ctx *sctx,
 	}
 
 out:
+	kfree(backref_ctx.cache_refs);
 	btrfs_free_path(tmp_path);
 	return ret;
 }
@@ -7541,6 +7743,8 @@ long btrfs_ioctl_send(struct file *mnt_file, struct btrfs_ioctl_send_args *arg)
 	INIT_LIST_HEAD(&sctx->deleted_refs);
 	INIT_RADIX_TREE(&sctx->name_cache, GFP_KERNEL);
 	INIT_LIST_HEAD(&sctx->name_cache_list);
+	sctx->backref_cache = RB_ROOT;
+	INIT_LIST_HEAD(&sctx->backref_cache_list);
 
 	sctx->flags = arg->flags;
 
@@ -7770,6 +7974,7 @@ long btrfs_ioctl_send(struct file *mnt_file, struct btrfs_ioctl_send_args *arg)
 		kvfree(sctx->send_buf);
 
 		name_cache_free(sctx);
+		backref_cache_free(sctx);
 
 		kfree(sctx);
 	}
@@ -2117,9 +2117,10 @@ int btrfs_commit_transaction(struct btrfs_trans_handle *trans)
 			      &cur_trans->delayed_refs.flags)) {
 		/*
 		 * Make a pass through all the delayed refs we have so far.
-		 * Any running threads may add more while we are here.
+		 * Any running threads may add more while we are here.  If
+		 * there are many, spread them over several threads.
 		 */
-		ret = btrfs_run_delayed_refs(trans, 0);
+		ret = btrfs_run_delayed_refs_parallel(trans);
 		if (ret) {
 			btrfs_end_transaction(trans);
 			return ret;
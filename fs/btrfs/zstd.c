@@ -13,6 +13,7 @@
 #include <linux/mm.h>
 #include <linux/sched/mm.h>
 #include <linux/pagemap.h>
+#include <linux/percpu.h>
 #include <linux/refcount.h>
 #include <linux/sched.h>
 #include <linux/slab.h>
@@ -70,6 +71,13 @@ struct workspace {
  * A timer is used to reclaim workspaces if they have not been used for
  * ZSTD_BTRFS_RECLAIM_JIFFIES.  This helps keep only active workspaces around.
  * The upper bound is provided by the workqueue limit which is 2 (percpu limit).
+ *
+ * In front of all of this each cpu caches the last workspace put on it.  The
+ * compression and decompression workers keep asking for the same level, so
+ * most gets and puts are served by an xchg on the local slot and never touch
+ * the global lock.  Cached workspaces are not on any list; they are aged out
+ * by the reclaim timer and stolen by tasks that would otherwise have to wait
+ * for a workspace to be put back.
  */
 
 struct zstd_workspace_manager {
@@ -84,6 +92,8 @@ struct zstd_workspace_manager {
 
 static struct zstd_workspace_manager wsm;
 
+static DEFINE_PER_CPU(struct list_head *, zstd_pcpu_ws);
+
 static size_t zstd_ws_mem_sizes[ZSTD_BTRFS_MAX_LEVEL];
 
 static inline struct workspace *list_to_workspace(struct list_head *list)
@@ -93,6 +103,7 @@ static inline struct workspace *list_to_workspace(struct list_head *list)
 
 void zstd_free_workspace(struct list_head *ws);
 struct list_head *zstd_alloc_workspace(unsigned int level);
+static void __zstd_put_workspace(struct list_head *ws);
 /*
  * zstd_reclaim_timer_fn - reclaim timer
  * @t: timer
@@ -104,10 +115,39 @@ static void zstd_reclaim_timer_fn(struct timer_list *timer)
 {
 	unsigned long reclaim_threshold = jiffies - ZSTD_BTRFS_RECLAIM_JIFFIES;
 	struct list_head *pos, *next;
+	bool pcpu_cached = false;
+	int cpu;
 
 	spin_lock_bh(&wsm.lock);
 
+	for_each_possible_cpu(cpu) {
+		struct list_head **slot = per_cpu_ptr(&zstd_pcpu_ws, cpu);
+		struct workspace *workspace;
+
+		if (!READ_ONCE(*slot))
+			continue;
+		pos = xchg(slot, NULL);
+		if (!pos)
+			continue;
+		workspace = list_to_workspace(pos);
+		if (!time_after(workspace->last_used, reclaim_threshold)) {
+			zstd_free_workspace(pos);
+			continue;
+		}
+		pcpu_cached = true;
+		if (cmpxchg(slot, NULL, pos) == NULL)
+			continue;
+		/* The slot got refilled meanwhile, keep it on the lru */
+		set_bit(workspace->level - 1, &wsm.active_map);
+		list_add(&workspace->list, &wsm.idle_ws[workspace->level - 1]);
+		list_add(&workspace->lru_list, &wsm.lru_list);
+		workspace->req_level = 0;
+	}
+
 	if (list_empty(&wsm.lru_list)) {
+		if (pcpu_cached)
+			mod_timer(&wsm.timer,
+				  jiffies + ZSTD_BTRFS_RECLAIM_JIFFIES);
 		spin_unlock_bh(&wsm.lock);
 		return;
 	}
@@ -134,7 +174,7 @@ static void zstd_reclaim_timer_fn(struct timer_list *timer)
 
 	}
 
-	if (!list_empty(&wsm.lru_list))
+	if (!list_empty(&wsm.lru_list) || pcpu_cached)
 		mod_timer(&wsm.timer, jiffies + ZSTD_BTRFS_RECLAIM_JIFFIES);
 
 	spin_unlock_bh(&wsm.lock);
@@ -196,8 +236,19 @@ void zstd_init_workspace_manager(void)
 void zstd_cleanup_workspace_manager(void)
 {
 	struct workspace *workspace;
+	struct list_head *ws;
+	int cpu;
 	int i;
 
+	/* The reclaim timer may put workspaces back into the per-cpu slots */
+	del_timer_sync(&wsm.timer);
+
+	for_each_possible_cpu(cpu) {
+		ws = xchg(per_cpu_ptr(&zstd_pcpu_ws, cpu), NULL);
+		if (ws)
+			zstd_free_workspace(ws);
+	}
+
 	spin_lock_bh(&wsm.lock);
 	for (i = 0; i < ZSTD_BTRFS_MAX_LEVEL; i++) {
 		while (!list_empty(&wsm.idle_ws[i])) {
@@ -209,8 +260,6 @@ void zstd_cleanup_workspace_manager(void)
 		}
 	}
 	spin_unlock_bh(&wsm.lock);
-
-	del_timer_sync(&wsm.timer);
 }
 
 /*
@@ -251,6 +300,61 @@ static struct list_head *zstd_find_workspace(unsigned int level)
 	return NULL;
 }
 
+/*
+ * Take the workspace cached on @cpu if it was allocated for @level.  With
+ * @steal set, any workspace that is big enough for @level is taken.
+ */
+static struct list_head *zstd_take_pcpu_workspace(int cpu, unsigned int level,
+						  bool steal)
+{
+	struct list_head **slot = per_cpu_ptr(&zstd_pcpu_ws, cpu);
+	struct workspace *workspace;
+	struct list_head *ws;
+
+	if (!READ_ONCE(*slot))
+		return NULL;
+	ws = xchg(slot, NULL);
+	if (!ws)
+		return NULL;
+
+	workspace = list_to_workspace(ws);
+	if (workspace->level == level) {
+		workspace->req_level = level;
+		return ws;
+	}
+	if (steal && workspace->level > level) {
+		/*
+		 * Used below its level, so like zstd_find_workspace() it must
+		 * stay on the lru while in use.
+		 */
+		workspace->req_level = level;
+		spin_lock_bh(&wsm.lock);
+		list_add(&workspace->lru_list, &wsm.lru_list);
+		if (!timer_pending(&wsm.timer))
+			mod_timer(&wsm.timer,
+				  jiffies + ZSTD_BTRFS_RECLAIM_JIFFIES);
+		spin_unlock_bh(&wsm.lock);
+		return ws;
+	}
+
+	/* Wrong level for us, hand it back to the global lists */
+	__zstd_put_workspace(ws);
+	return NULL;
+}
+
+static struct list_head *zstd_steal_workspace(unsigned int level)
+{
+	struct list_head *ws;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		ws = zstd_take_pcpu_workspace(cpu, level, true);
+		if (ws)
+			return ws;
+	}
+	return NULL;
+}
+
 /*
  * zstd_get_workspace - zstd's get_workspace
  * @level: compression level
@@ -269,6 +373,10 @@ struct list_head *zstd_get_workspace(unsigned int level)
 	if (!level)
 		level = 1;
 
+	ws = zstd_take_pcpu_workspace(raw_smp_processor_id(), level, false);
+	if (ws)
+		return ws;
+
 again:
 	ws = zstd_find_workspace(level);
 	if (ws)
@@ -282,6 +390,11 @@ struct list_head *zstd_get_workspace(unsigned int level)
 		DEFINE_WAIT(wait);
 
 		prepare_to_wait(&wsm.wait, &wait, TASK_UNINTERRUPTIBLE);
+		ws = zstd_steal_workspace(level);
+		if (ws) {
+			finish_wait(&wsm.wait, &wait);
+			return ws;
+		}
 		schedule();
 		finish_wait(&wsm.wait, &wait);
 
@@ -301,7 +414,7 @@ struct list_head *zstd_get_workspace(unsigned int level)
  * isn't set, it is also set here.  Only the max level workspace tries and wakes
  * up waiting workspaces.
  */
-void zstd_put_workspace(struct list_head *ws)
+static void __zstd_put_workspace(struct list_head *ws)
 {
 	struct workspace *workspace = list_to_workspace(ws);
 
@@ -331,6 +444,36 @@ void zstd_put_workspace(struct list_head *ws)
 		cond_wake_up(&wsm.wait);
 }
 
+void zstd_put_workspace(struct list_head *ws)
+{
+	struct workspace *workspace = list_to_workspace(ws);
+	struct list_head **slot;
+
+	/*
+	 * Only workspaces used at their own level are off the lru and can be
+	 * parked on the local cpu, the others keep their place in the lru.
+	 * Max level workspaces always go back to the global lists, so the one
+	 * guaranteeing forward progress can't be aged out of a cpu slot.
+	 */
+	if (workspace->req_level != workspace->level ||
+	    workspace->level == ZSTD_BTRFS_MAX_LEVEL) {
+		__zstd_put_workspace(ws);
+		return;
+	}
+
+	workspace->last_used = jiffies;
+	slot = raw_cpu_ptr(&zstd_pcpu_ws);
+	if (READ_ONCE(*slot) || cmpxchg(slot, NULL, ws) != NULL) {
+		__zstd_put_workspace(ws);
+		return;
+	}
+
+	if (!timer_pending(&wsm.timer))
+		mod_timer(&wsm.timer, jiffies + ZSTD_BTRFS_RECLAIM_JIFFIES);
+	/* Pairs with the steal attempt in zstd_get_workspace() */
+	cond_wake_up(&wsm.wait);
+}
+
 void zstd_free_workspace(struct list_head *ws)
 {
 	struct workspace *workspace = list_entry(ws, struct workspace, list);
@@ -432,4 +432,6 @@ const struct file_operations erofs_file_fops = {
 	.read_iter	= erofs_file_read_iter,
 	.mmap		= erofs_file_mmap,
 	.splice_read	= generic_file_splice_read,
+	.open		= erofs_ishare_open,
+	.release	= erofs_ishare_release,
 };
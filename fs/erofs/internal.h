@@ -113,6 +113,12 @@ struct erofs_sb_info {
 	struct inode *managed_cache;
 
 	struct erofs_sb_lz4_info lz4;
+
+	/* decompression statistics, exported in sysfs */
+	atomic64_t decompressed_pclusters;
+	atomic64_t decompress_ns;
+	atomic64_t queued_decompressions;
+	atomic64_t queue_wait_ns;
 #endif	/* CONFIG_EROFS_FS_ZIP */
 	struct erofs_dev_context *devs;
 	struct dax_device *dax_dev;
@@ -156,6 +162,7 @@ struct erofs_sb_info {
 #define EROFS_MOUNT_POSIX_ACL		0x00000020
 #define EROFS_MOUNT_DAX_ALWAYS		0x00000040
 #define EROFS_MOUNT_DAX_NEVER		0x00000080
+#define EROFS_MOUNT_INODE_SHARE		0x00000100
 
 #define clear_opt(opt, option)	((opt)->mount_opt &= ~EROFS_MOUNT_##option)
 #define set_opt(opt, option)	((opt)->mount_opt |= EROFS_MOUNT_##option)
@@ -535,6 +542,15 @@ int erofs_pcpubuf_growsize(unsigned int nrpages);
 void erofs_pcpubuf_init(void);
 void erofs_pcpubuf_exit(void);
 
+/* ishare.c */
+#ifdef CONFIG_EROFS_FS_XATTR
+int erofs_ishare_open(struct inode *inode, struct file *file);
+int erofs_ishare_release(struct inode *inode, struct file *file);
+#else
+#define erofs_ishare_open (NULL)
+#define erofs_ishare_release (NULL)
+#endif
+
 /* sysfs.c */
 int erofs_register_sysfs(struct super_block *sb);
 void erofs_unregister_sysfs(struct super_block *sb);
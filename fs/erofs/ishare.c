@@ -0,0 +1,126 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * Share the page cache of identical regular files across erofs instances.
+ *
+ * Container images built from the same base layers carry many byte-identical
+ * files (shared libraries, interpreters, ...).  If an image builder records a
+ * content digest of such a file in the "trusted.erofs.fingerprint" xattr and
+ * the filesystem is mounted with "-o inode_share", all opens of files with
+ * the same fingerprint and size are redirected to the page cache of the first
+ * inode seen, whichever image it came from.  The owning inode and its
+ * superblock are pinned until the last sharer goes away.
+ *
+ * The fingerprint comes from the image itself, so this must only be enabled
+ * for images which are trusted not to lie about their contents.
+ */
+#include <linux/hashtable.h>
+#include <linux/jhash.h>
+#include "xattr.h"
+
+#define EROFS_ISHARE_XATTR		"erofs.fingerprint"
+#define EROFS_ISHARE_FPRINT_MAX		64
+#define EROFS_ISHARE_HASH_BITS		10
+
+struct erofs_ishare {
+	struct hlist_node node;
+	struct inode *owner;		/* whose page cache is shared */
+	loff_t size;
+	unsigned int refs;		/* open files using this entry */
+	unsigned int fplen;
+	u8 fingerprint[];
+};
+
+static DEFINE_HASHTABLE(erofs_ishare_table, EROFS_ISHARE_HASH_BITS);
+static DEFINE_MUTEX(erofs_ishare_lock);
+
+static u32 erofs_ishare_hash(const u8 *fp, unsigned int fplen, loff_t size)
+{
+	return jhash(fp, fplen, (u32)size ^ (u32)(size >> 32));
+}
+
+static struct erofs_ishare *erofs_ishare_lookup(const u8 *fp,
+						unsigned int fplen,
+						loff_t size, u32 hash)
+{
+	struct erofs_ishare *ish;
+
+	hash_for_each_possible(erofs_ishare_table, ish, node, hash)
+		if (ish->size == size && ish->fplen == fplen &&
+		    !memcmp(ish->fingerprint, fp, fplen))
+			return ish;
+	return NULL;
+}
+
+int erofs_ishare_open(struct inode *inode, struct file *file)
+{
+	u8 fp[EROFS_ISHARE_FPRINT_MAX];
+	struct erofs_ishare *ish;
+	int fplen;
+	u32 hash;
+
+	/* compressed files keep their private cache */
+	if (!test_opt(&EROFS_I_SB(inode)->opt, INODE_SHARE) ||
+	    !S_ISREG(inode->i_mode) || IS_DAX(inode) ||
+	    erofs_inode_is_data_compressed(EROFS_I(inode)->datalayout))
+		return 0;
+
+	fplen = erofs_getxattr(inode, EROFS_XATTR_INDEX_TRUSTED,
+			       EROFS_ISHARE_XATTR, fp, sizeof(fp));
+	/* files without a usable fingerprint just use their own cache */
+	if (fplen <= 0)
+		return 0;
+
+	hash = erofs_ishare_hash(fp, fplen, inode->i_size);
+	mutex_lock(&erofs_ishare_lock);
+	ish = erofs_ishare_lookup(fp, fplen, inode->i_size, hash);
+	if (ish) {
+		++ish->refs;
+		goto out;
+	}
+
+	ish = kmalloc(struct_size(ish, fingerprint, fplen), GFP_KERNEL);
+	if (!ish) {
+		mutex_unlock(&erofs_ishare_lock);
+		return -ENOMEM;
+	}
+	memcpy(ish->fingerprint, fp, fplen);
+	ish->fplen = fplen;
+	ish->size = inode->i_size;
+	ish->refs = 1;
+	ish->owner = inode;
+	/* keep the owner usable even if its own image is unmounted meanwhile */
+	ihold(inode);
+	atomic_inc(&inode->i_sb->s_active);
+	hash_add(erofs_ishare_table, &ish->node, hash);
+out:
+	mutex_unlock(&erofs_ishare_lock);
+	file->private_data = ish;
+	/* ->f_ra is initialized from ->f_mapping after ->open returns */
+	file->f_mapping = ish->owner->i_mapping;
+	return 0;
+}
+
+int erofs_ishare_release(struct inode *inode, struct file *file)
+{
+	struct erofs_ishare *ish = file->private_data;
+	struct super_block *sb;
+	struct inode *owner;
+
+	if (!ish)
+		return 0;
+
+	mutex_lock(&erofs_ishare_lock);
+	if (--ish->refs) {
+		mutex_unlock(&erofs_ishare_lock);
+		return 0;
+	}
+	hash_del(&ish->node);
+	mutex_unlock(&erofs_ishare_lock);
+
+	owner = ish->owner;
+	sb = owner->i_sb;
+	kfree(ish);
+	iput(owner);
+	deactivate_super(sb);
+	return 0;
+}
@@ -393,6 +393,7 @@ enum {
 	Opt_dax,
 	Opt_dax_enum,
 	Opt_device,
+	Opt_inode_share,
 	Opt_err
 };
 
@@ -417,6 +418,7 @@ static const struct fs_parameter_spec erofs_fs_parameters[] = {
 	fsparam_flag("dax",             Opt_dax),
 	fsparam_enum("dax",		Opt_dax_enum, erofs_dax_param_enums),
 	fsparam_string("device",	Opt_device),
+	fsparam_flag("inode_share",	Opt_inode_share),
 	{}
 };
 
@@ -512,6 +514,13 @@ static int erofs_fc_parse_param(struct fs_context *fc,
 		}
 		++ctx->devs->extra_devices;
 		break;
+	case Opt_inode_share:
+#ifdef CONFIG_EROFS_FS_XATTR
+		set_opt(&ctx->opt, INODE_SHARE);
+#else
+		errorfc(fc, "inode_share option not supported");
+#endif
+		break;
 	default:
 		return -ENOPARAM;
 	}
@@ -902,6 +911,8 @@ static int erofs_show_options(struct seq_file *seq, struct dentry *root)
 		seq_puts(seq, ",dax=always");
 	if (test_opt(opt, DAX_NEVER))
 		seq_puts(seq, ",dax=never");
+	if (test_opt(opt, INODE_SHARE))
+		seq_puts(seq, ",inode_share");
 	return 0;
 }
 
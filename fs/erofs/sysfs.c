@@ -12,6 +12,7 @@ enum {
 	attr_feature,
 	attr_pointer_ui,
 	attr_pointer_bool,
+	attr_pointer_atomic64,
 };
 
 enum {
@@ -53,15 +54,26 @@ static struct erofs_attr erofs_attr_##_name = {			\
 #define EROFS_ATTR_RW_BOOL(_name, _struct)	\
 	EROFS_ATTR_RW(_name, pointer_bool, _struct)
 
+#define EROFS_RO_ATTR_ATOMIC64(_name, _struct)	\
+	EROFS_RO_ATTR(_name, pointer_atomic64, _struct)
+
 #define ATTR_LIST(name) (&erofs_attr_##name.attr)
 
 #ifdef CONFIG_EROFS_FS_ZIP
 EROFS_ATTR_RW_UI(sync_decompress, erofs_mount_opts);
+EROFS_RO_ATTR_ATOMIC64(decompressed_pclusters, erofs_sb_info);
+EROFS_RO_ATTR_ATOMIC64(decompress_ns, erofs_sb_info);
+EROFS_RO_ATTR_ATOMIC64(queued_decompressions, erofs_sb_info);
+EROFS_RO_ATTR_ATOMIC64(queue_wait_ns, erofs_sb_info);
 #endif
 
 static struct attribute *erofs_attrs[] = {
 #ifdef CONFIG_EROFS_FS_ZIP
 	ATTR_LIST(sync_decompress),
+	ATTR_LIST(decompressed_pclusters),
+	ATTR_LIST(decompress_ns),
+	ATTR_LIST(queued_decompressions),
+	ATTR_LIST(queue_wait_ns),
 #endif
 	NULL,
 };
@@ -119,6 +131,11 @@ static ssize_t erofs_attr_show(struct kobject *kobj,
 		if (!ptr)
 			return 0;
 		return sysfs_emit(buf, "%d\n", *(bool *)ptr);
+	case attr_pointer_atomic64:
+		if (!ptr)
+			return 0;
+		return sysfs_emit(buf, "%lld\n",
+				  (s64)atomic64_read((atomic64_t *)ptr));
 	}
 	return 0;
 }
@@ -829,6 +829,7 @@ static int z_erofs_decompress_pcluster(struct super_block *sb,
 	enum z_erofs_page_type page_type;
 	bool overlapped, partial;
 	struct z_erofs_collection *cl;
+	u64 start_ns;
 	int err;
 
 	might_sleep();
@@ -965,6 +966,7 @@ static int z_erofs_decompress_pcluster(struct super_block *sb,
 	else
 		inputsize = pclusterpages * PAGE_SIZE;
 
+	start_ns = ktime_get_ns();
 	err = z_erofs_decompress(&(struct z_erofs_decompress_req) {
 					.sb = sb,
 					.in = compressed_pages,
@@ -977,6 +979,8 @@ static int z_erofs_decompress_pcluster(struct super_block *sb,
 					.inplace_io = overlapped,
 					.partial_decoding = partial
 				 }, pagepool);
+	atomic64_add(ktime_get_ns() - start_ns, &sbi->decompress_ns);
+	atomic64_inc(&sbi->decompressed_pclusters);
 
 out:
 	/* must handle all compressed pages before actual file pages */
@@ -1053,6 +1057,85 @@ static void z_erofs_decompress_queue(const struct z_erofs_decompressqueue *io,
 	}
 }
 
+/* don't spread a queue over more workers than this many pclusters each */
+#define Z_EROFS_SPLIT_MIN_PCLUSTERS	4
+
+static void z_erofs_account_queue_wait(struct z_erofs_decompressqueue *q)
+{
+	struct erofs_sb_info *const sbi = EROFS_SB(q->sb);
+
+	if (!q->queued_ns)
+		return;
+	atomic64_inc(&sbi->queued_decompressions);
+	atomic64_add(ktime_get_ns() - q->queued_ns, &sbi->queue_wait_ns);
+}
+
+static void z_erofs_decompressqueue_part_work(struct work_struct *work)
+{
+	struct z_erofs_decompressqueue *q =
+		container_of(work, struct z_erofs_decompressqueue, u.work);
+	struct page *pagepool = NULL;
+
+	z_erofs_account_queue_wait(q);
+	z_erofs_decompress_queue(q, &pagepool);
+
+	erofs_release_pages(&pagepool);
+	kvfree(q);
+}
+
+/*
+ * Pclusters are decompressed independently of each other, so instead of
+ * working through a long background queue on one cpu, cut it into up to one
+ * part per online cpu and hand all but the first part to other workers.
+ * The chain is cut by closing it early, so each part is only queued once its
+ * end is set.  If an allocation fails, the rest just stays with us.
+ */
+static void z_erofs_split_queue(struct z_erofs_decompressqueue *bgq)
+{
+	z_erofs_next_pcluster_t owned = bgq->head;
+	struct z_erofs_decompressqueue *part = NULL;
+	struct z_erofs_pcluster *pcl;
+	unsigned int nr = 0, nr_parts, per_part;
+
+	while (owned != Z_EROFS_PCLUSTER_TAIL_CLOSED) {
+		pcl = container_of(owned, struct z_erofs_pcluster, next);
+		owned = READ_ONCE(pcl->next);
+		++nr;
+	}
+
+	nr_parts = min(num_online_cpus(), nr / Z_EROFS_SPLIT_MIN_PCLUSTERS);
+	if (nr_parts < 2)
+		return;
+	per_part = DIV_ROUND_UP(nr, nr_parts);
+
+	owned = bgq->head;
+	nr = 0;
+	while (owned != Z_EROFS_PCLUSTER_TAIL_CLOSED) {
+		struct z_erofs_decompressqueue *q;
+
+		pcl = container_of(owned, struct z_erofs_pcluster, next);
+		owned = READ_ONCE(pcl->next);
+		if (++nr % per_part || owned == Z_EROFS_PCLUSTER_TAIL_CLOSED)
+			continue;
+
+		q = kvzalloc(sizeof(*q), GFP_KERNEL | __GFP_NOWARN);
+		if (!q)
+			break;
+		/* pcl ends the current part, the next one starts at owned */
+		WRITE_ONCE(pcl->next, Z_EROFS_PCLUSTER_TAIL_CLOSED);
+		if (part)
+			queue_work(z_erofs_workqueue, &part->u.work);
+
+		q->sb = bgq->sb;
+		q->head = owned;
+		q->queued_ns = ktime_get_ns();
+		INIT_WORK(&q->u.work, z_erofs_decompressqueue_part_work);
+		part = q;
+	}
+	if (part)
+		queue_work(z_erofs_workqueue, &part->u.work);
+}
+
 static void z_erofs_decompressqueue_work(struct work_struct *work)
 {
 	struct z_erofs_decompressqueue *bgq =
@@ -1060,6 +1143,8 @@ static void z_erofs_decompressqueue_work(struct work_struct *work)
 	struct page *pagepool = NULL;
 
 	DBG_BUGON(bgq->head == Z_EROFS_PCLUSTER_TAIL_CLOSED);
+	z_erofs_account_queue_wait(bgq);
+	z_erofs_split_queue(bgq);
 	z_erofs_decompress_queue(bgq, &pagepool);
 
 	erofs_release_pages(&pagepool);
@@ -1083,6 +1168,7 @@ static void z_erofs_decompress_kickoff(struct z_erofs_decompressqueue *io,
 		return;
 	/* Use workqueue and sync decompression for atomic contexts only */
 	if (in_atomic() || irqs_disabled()) {
+		io->queued_ns = ktime_get_ns();
 		queue_work(z_erofs_workqueue, &io->u.work);
 		/* enable sync decompression for readahead */
 		if (sbi->opt.sync_decompress == EROFS_SYNC_DECOMPRESS_AUTO)
@@ -95,6 +95,8 @@ struct z_erofs_decompressqueue {
 	struct super_block *sb;
 	atomic_t pending_bios;
 	z_erofs_next_pcluster_t head;
+	/* when a background queue was handed to the workqueue */
+	u64 queued_ns;
 
 	union {
 		struct completion done;
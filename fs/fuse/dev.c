@@ -204,15 +204,72 @@ static unsigned int fuse_req_hash(u64 unique)
 	return hash_long(unique & ~FUSE_INT_REQ_BIT, FUSE_PQ_HASH_BITS);
 }
 
+/*
+ * Wake up one reader sleeping on a per-CPU queue, preferring the current
+ * CPU.  Only CPUs in fiq->cpu_readers are looked at, and those found without
+ * sleeping readers are dropped from it.  Returns false if there is no reader
+ * to wake.
+ */
+static bool fuse_wake_cpu_reader(struct fuse_iqueue *fiq,
+				 struct fuse_iqueue_cpu __percpu *iqcs)
+{
+	struct fuse_iqueue_cpu *iqc;
+	unsigned long flags;
+	bool woken;
+	int cpu;
+
+	/* Pairs with smp_mb() in fuse_wait_cpu_queue() */
+	smp_mb();
+	for_each_cpu_wrap(cpu, fiq->cpu_readers, raw_smp_processor_id()) {
+		iqc = per_cpu_ptr(iqcs, cpu);
+		spin_lock_irqsave(&iqc->waitq.lock, flags);
+		woken = waitqueue_active(&iqc->waitq);
+		if (woken)
+			wake_up_locked(&iqc->waitq);
+		else
+			cpumask_clear_cpu(cpu, fiq->cpu_readers);
+		spin_unlock_irqrestore(&iqc->waitq.lock, flags);
+		if (woken)
+			return true;
+	}
+	return false;
+}
+
 /**
- * A new request is available, wake fiq->waitq
+ * A new request is available, wake a reader
  */
 static void fuse_dev_wake_and_unlock(struct fuse_iqueue *fiq)
 __releases(fiq->lock)
 {
-	wake_up(&fiq->waitq);
+	struct fuse_iqueue_cpu __percpu *iqcs = fiq->cpu_queues;
+
 	kill_fasync(&fiq->fasync, SIGIO, POLL_IN);
 	spin_unlock(&fiq->lock);
+
+	if (!iqcs || !fuse_wake_cpu_reader(fiq, iqcs))
+		wake_up(&fiq->waitq);
+}
+
+/* Called with iqc->lock held */
+static void fuse_iqc_add(struct fuse_iqueue *fiq, struct fuse_iqueue_cpu *iqc,
+			 struct fuse_req *req)
+{
+	if (list_empty(&iqc->pending))
+		cpumask_set_cpu(iqc->cpu, fiq->cpu_pending_mask);
+	list_add_tail(&req->list, &iqc->pending);
+	req->iqc = iqc;
+	/* Pairs with smp_rmb() in fuse_dequeue_cpu_request() */
+	smp_mb__before_atomic();
+	atomic_inc(&fiq->cpu_pending);
+}
+
+/* Called with iqc->lock held, after a request was taken off iqc->pending */
+static void fuse_iqc_removed(struct fuse_iqueue *fiq,
+			     struct fuse_iqueue_cpu *iqc)
+{
+	atomic_dec(&fiq->cpu_pending);
+	if (list_empty(&iqc->pending))
+		cpumask_clear_cpu(iqc->cpu, fiq->cpu_pending_mask);
 }
 
 const struct fuse_iqueue_ops fuse_dev_fiq_ops = {
@@ -229,7 +286,15 @@ __releases(fiq->lock)
 	req->in.h.len = sizeof(struct fuse_in_header) +
 		fuse_len_args(req->args->in_numargs,
 			      (struct fuse_arg *) req->args->in_args);
-	list_add_tail(&req->list, &fiq->pending);
+	if (fiq->cpu_queues) {
+		struct fuse_iqueue_cpu *iqc = this_cpu_ptr(fiq->cpu_queues);
+
+		spin_lock(&iqc->lock);
+		fuse_iqc_add(fiq, iqc, req);
+		spin_unlock(&iqc->lock);
+	} else {
+		list_add_tail(&req->list, &fiq->pending);
+	}
 	fiq->ops->wake_pending_and_unlock(fiq);
 }
 
@@ -393,14 +458,22 @@ static void request_wait_answer(struct fuse_req *req)
 			return;
 
 		spin_lock(&fiq->lock);
+		if (req->iqc)
+			spin_lock(&req->iqc->lock);
 		/* Request is not yet in userspace, bail out */
 		if (test_bit(FR_PENDING, &req->flags)) {
 			list_del(&req->list);
+			if (req->iqc) {
+				fuse_iqc_removed(fiq, req->iqc);
+				spin_unlock(&req->iqc->lock);
+			}
 			spin_unlock(&fiq->lock);
 			__fuse_put_request(req);
 			req->out.h.error = -EINTR;
 			return;
 		}
+		if (req->iqc)
+			spin_unlock(&req->iqc->lock);
 		spin_unlock(&fiq->lock);
 	}
 
@@ -1037,10 +1110,79 @@ static int forget_pending(struct fuse_iqueue *fiq)
 	return fiq->forget_list_head.next != NULL;
 }
 
+static bool cpu_request_pending(struct fuse_iqueue *fiq)
+{
+	return atomic_read(&fiq->cpu_pending) != 0;
+}
+
 static int request_pending(struct fuse_iqueue *fiq)
 {
 	return !list_empty(&fiq->pending) || !list_empty(&fiq->interrupts) ||
-		forget_pending(fiq);
+		forget_pending(fiq) || cpu_request_pending(fiq);
+}
+
+/*
+ * Take the oldest request off the per-CPU queues, starting with the queue of
+ * the current CPU and then helping out the others.  Doesn't need fiq->lock.
+ */
+static struct fuse_req *fuse_dequeue_cpu_request(struct fuse_iqueue *fiq,
+			struct fuse_iqueue_cpu __percpu *iqcs)
+{
+	struct fuse_iqueue_cpu *iqc;
+	struct fuse_req *req;
+	int cpu;
+
+	if (!cpu_request_pending(fiq))
+		return NULL;
+
+	/* Pairs with smp_mb__before_atomic() in fuse_iqc_add() */
+	smp_rmb();
+	for_each_cpu_wrap(cpu, fiq->cpu_pending_mask, raw_smp_processor_id()) {
+		iqc = per_cpu_ptr(iqcs, cpu);
+		spin_lock(&iqc->lock);
+		req = list_first_entry_or_null(&iqc->pending, struct fuse_req,
+					       list);
+		if (req) {
+			clear_bit(FR_PENDING, &req->flags);
+			list_del_init(&req->list);
+			fuse_iqc_removed(fiq, iqc);
+		}
+		spin_unlock(&iqc->lock);
+		if (req)
+			return req;
+	}
+	return NULL;
+}
+
+/*
+ * Sleep on the per-CPU wait queue of @iqc until there is something to read.
+ * The CPU is marked in fiq->cpu_readers only after the reader is on the wait
+ * queue, so a waker that finds the wait queue empty under its lock may clear
+ * the mark.
+ */
+static int fuse_wait_cpu_queue(struct fuse_iqueue *fiq,
+			       struct fuse_iqueue_cpu *iqc)
+{
+	DEFINE_WAIT(wait);
+	int err = 0;
+
+	for (;;) {
+		prepare_to_wait_exclusive(&iqc->waitq, &wait,
+					  TASK_INTERRUPTIBLE);
+		if (!cpumask_test_cpu(iqc->cpu, fiq->cpu_readers))
+			cpumask_set_cpu(iqc->cpu, fiq->cpu_readers);
+		/* Pairs with smp_mb() in fuse_wake_cpu_reader() */
+		smp_mb();
+		if (!fiq->connected || request_pending(fiq))
+			break;
+		if (signal_pending(current)) {
+			err = -ERESTARTSYS;
+			break;
+		}
+		schedule();
+	}
+	finish_wait(&iqc->waitq, &wait);
+	return err;
 }
 
 /*
@@ -1206,12 +1348,13 @@ __releases(fiq->lock)
  * fuse_request_end().  Otherwise add it to the processing list, and set
  * the 'sent' flag.
  */
-static ssize_t fuse_dev_do_read(struct fuse_dev *fud, struct file *file,
+static ssize_t fuse_dev_do_read(struct fuse_dev *fud, bool nonblock,
 				struct fuse_copy_state *cs, size_t nbytes)
 {
 	ssize_t err;
 	struct fuse_conn *fc = fud->fc;
 	struct fuse_iqueue *fiq = &fc->iq;
+	struct fuse_iqueue_cpu __percpu *iqcs;
 	struct fuse_pqueue *fpq = &fud->pq;
 	struct fuse_req *req;
 	struct fuse_args *args;
@@ -1238,14 +1381,29 @@ static ssize_t fuse_dev_do_read(struct fuse_dev *fud, struct file *file,
 
  restart:
 	for (;;) {
+		/*
+		 * Serve the per-CPU queues without taking fiq->lock, unless
+		 * interrupts or forgets are waiting to be sent first.
+		 */
+		iqcs = smp_load_acquire(&fiq->cpu_queues);
+		if (iqcs && list_empty_careful(&fiq->interrupts) &&
+		    !forget_pending(fiq)) {
+			req = fuse_dequeue_cpu_request(fiq, iqcs);
+			if (req)
+				goto found;
+		}
+
 		spin_lock(&fiq->lock);
 		if (!fiq->connected || request_pending(fiq))
 			break;
 		spin_unlock(&fiq->lock);
 
-		if (file->f_flags & O_NONBLOCK)
+		if (nonblock)
 			return -EAGAIN;
-		err = wait_event_interruptible_exclusive(fiq->waitq,
+		if (iqcs)
+			err = fuse_wait_cpu_queue(fiq, raw_cpu_ptr(iqcs));
+		else
+			err = wait_event_interruptible_exclusive(fiq->waitq,
 				!fiq->connected || request_pending(fiq));
 		if (err)
 			return err;
@@ -1263,18 +1421,29 @@ static ssize_t fuse_dev_do_read(struct fuse_dev *fud, struct file *file,
 	}
 
 	if (forget_pending(fiq)) {
-		if (list_empty(&fiq->pending) || fiq->forget_batch-- > 0)
+		if ((list_empty(&fiq->pending) && !cpu_request_pending(fiq)) ||
+		    fiq->forget_batch-- > 0)
 			return fuse_read_forget(fc, fiq, cs, nbytes);
 
 		if (fiq->forget_batch <= -8)
 			fiq->forget_batch = 16;
 	}
 
-	req = list_entry(fiq->pending.next, struct fuse_req, list);
-	clear_bit(FR_PENDING, &req->flags);
-	list_del_init(&req->list);
-	spin_unlock(&fiq->lock);
+	if (list_empty(&fiq->pending)) {
+		/* Only the per-CPU queues have requests */
+		iqcs = fiq->cpu_queues;
+		spin_unlock(&fiq->lock);
+		req = fuse_dequeue_cpu_request(fiq, iqcs);
+		if (!req)
+			goto restart;
+	} else {
+		req = list_entry(fiq->pending.next, struct fuse_req, list);
+		clear_bit(FR_PENDING, &req->flags);
+		list_del_init(&req->list);
+		spin_unlock(&fiq->lock);
+	}
 
+found:
 	args = req->args;
 	reqsize = req->in.h.len;
 
@@ -1352,6 +1521,12 @@ static int fuse_dev_open(struct inode *inode, struct file *file)
 	 * keep track of whether the file has been mounted already.
 	 */
 	file->private_data = NULL;
+	/*
+	 * Reads honour IOCB_NOWAIT, so io_uring can issue them inline and fall
+	 * back to ->poll() instead of handing every read to a worker thread.
+	 * Writes may sleep and return -EAGAIN under IOCB_NOWAIT.
+	 */
+	file->f_mode |= FMODE_NOWAIT;
 	return 0;
 }
 
@@ -1369,7 +1544,9 @@ static ssize_t fuse_dev_read(struct kiocb *iocb, struct iov_iter *to)
 
 	fuse_copy_init(&cs, 1, to);
 
-	return fuse_dev_do_read(fud, file, &cs, iov_iter_count(to));
+	return fuse_dev_do_read(fud, (file->f_flags & O_NONBLOCK) ||
+				(iocb->ki_flags & IOCB_NOWAIT),
+				&cs, iov_iter_count(to));
 }
 
 static ssize_t fuse_dev_splice_read(struct file *in, loff_t *ppos,
@@ -1393,7 +1570,7 @@ static ssize_t fuse_dev_splice_read(struct file *in, loff_t *ppos,
 	fuse_copy_init(&cs, 1, NULL);
 	cs.pipebufs = bufs;
 	cs.pipe = pipe;
-	ret = fuse_dev_do_read(fud, in, &cs, len);
+	ret = fuse_dev_do_read(fud, in->f_flags & O_NONBLOCK, &cs, len);
 	if (ret < 0)
 		goto out;
 
@@ -1960,6 +2137,13 @@ static ssize_t fuse_dev_write(struct kiocb *iocb, struct iov_iter *from)
 	if (!iter_is_iovec(from))
 		return -EINVAL;
 
+	/*
+	 * Replies lock and fill pages, and notifications take inode locks and
+	 * invalidate the page cache, so let io_uring issue them from a worker.
+	 */
+	if (iocb->ki_flags & IOCB_NOWAIT)
+		return -EAGAIN;
+
 	fuse_copy_init(&cs, 0, from);
 
 	return fuse_dev_do_write(fud, &cs, iov_iter_count(from));
@@ -2081,6 +2265,79 @@ static __poll_t fuse_dev_poll(struct file *file, poll_table *wait)
 	return mask;
 }
 
+/*
+ * Move all requests still pending on the per-CPU queues to @to_end and wake
+ * up the readers sleeping there.  Called with fiq->lock held.
+ */
+static void fuse_abort_cpu_queues(struct fuse_iqueue *fiq,
+				  struct list_head *to_end)
+{
+	struct fuse_iqueue_cpu *iqc;
+	struct fuse_req *req;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		iqc = per_cpu_ptr(fiq->cpu_queues, cpu);
+		spin_lock(&iqc->lock);
+		list_for_each_entry(req, &iqc->pending, list) {
+			clear_bit(FR_PENDING, &req->flags);
+			atomic_dec(&fiq->cpu_pending);
+		}
+		list_splice_tail_init(&iqc->pending, to_end);
+		cpumask_clear_cpu(cpu, fiq->cpu_pending_mask);
+		spin_unlock(&iqc->lock);
+		wake_up_all(&iqc->waitq);
+	}
+}
+
+/*
+ * Set up per-CPU input queues once the daemon starts reading through more
+ * than one device file.  On failure, keep using the shared queue.  Called with
+ * fuse_mutex held, which serializes the allocation of the CPU masks; they are
+ * freed together with the connection.
+ */
+static void fuse_iqueue_enable_cpu_queues(struct fuse_iqueue *fiq)
+{
+	struct fuse_iqueue_cpu __percpu *iqcs;
+	struct fuse_iqueue_cpu *iqc;
+	int cpu;
+
+	/* Other transports consume fiq->pending directly */
+	if (fiq->ops != &fuse_dev_fiq_ops || num_possible_cpus() == 1 ||
+	    READ_ONCE(fiq->cpu_queues))
+		return;
+
+	if (!cpumask_available(fiq->cpu_pending_mask) &&
+	    !zalloc_cpumask_var(&fiq->cpu_pending_mask, GFP_KERNEL))
+		return;
+	if (!cpumask_available(fiq->cpu_readers) &&
+	    !zalloc_cpumask_var(&fiq->cpu_readers, GFP_KERNEL))
+		return;
+
+	iqcs = alloc_percpu(struct fuse_iqueue_cpu);
+	if (!iqcs)
+		return;
+
+	for_each_possible_cpu(cpu) {
+		iqc = per_cpu_ptr(iqcs, cpu);
+		spin_lock_init(&iqc->lock);
+		INIT_LIST_HEAD(&iqc->pending);
+		init_waitqueue_head(&iqc->waitq);
+		iqc->cpu = cpu;
+	}
+
+	spin_lock(&fiq->lock);
+	if (fiq->connected && !fiq->cpu_queues) {
+		/* Pairs with smp_load_acquire() in lockless readers */
+		smp_store_release(&fiq->cpu_queues, iqcs);
+		iqcs = NULL;
+		/* Move sleeping readers over to the per-CPU wait queues */
+		wake_up_all(&fiq->waitq);
+	}
+	spin_unlock(&fiq->lock);
+	free_percpu(iqcs);
+}
+
 /* Abort all requests on the given list (pending or processing) */
 static void end_requests(struct list_head *head)
 {
@@ -2176,6 +2433,8 @@ void fuse_abort_conn(struct fuse_conn *fc)
 		list_for_each_entry(req, &fiq->pending, list)
 			clear_bit(FR_PENDING, &req->flags);
 		list_splice_tail_init(&fiq->pending, &to_end);
+		if (fiq->cpu_queues)
+			fuse_abort_cpu_queues(fiq, &to_end);
 		while (forget_pending(fiq))
 			kfree(fuse_dequeue_forget(fiq, 1, NULL));
 		wake_up_all(&fiq->waitq);
@@ -2282,12 +2541,37 @@ static long fuse_dev_ioctl(struct file *file, unsigned int cmd,
 				if (fud) {
 					mutex_lock(&fuse_mutex);
 					res = fuse_device_clone(fud->fc, file);
+					if (!res)
+						fuse_iqueue_enable_cpu_queues(
+								&fud->fc->iq);
 					mutex_unlock(&fuse_mutex);
 				}
 				fput(old);
 			}
 		}
 		break;
+	case FUSE_DEV_IOC_BACKING_OPEN: {
+		struct fuse_backing_map map;
+
+		res = -EFAULT;
+		fud = fuse_get_dev(file);
+		if (!fud)
+			res = -EPERM;
+		else if (!copy_from_user(&map, (void __user *)arg, sizeof(map)))
+			res = fuse_backing_open(fud->fc, &map);
+		break;
+	}
+	case FUSE_DEV_IOC_BACKING_CLOSE: {
+		int backing_id;
+
+		res = -EFAULT;
+		fud = fuse_get_dev(file);
+		if (!fud)
+			res = -EPERM;
+		else if (!get_user(backing_id, (int __user *)arg))
+			res = fuse_backing_close(fud->fc, backing_id);
+		break;
+	}
 	default:
 		res = -ENOTTY;
 		break;
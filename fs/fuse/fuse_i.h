@@ -35,9 +35,12 @@
 /** Default max number of pages that can be used in a single read request */
 #define FUSE_DEFAULT_MAX_PAGES_PER_REQ 32
 
-/** Maximum of max_pages received in init_out */
+/** Default maximum of max_pages received in init_out */
 #define FUSE_MAX_MAX_PAGES 256
 
+/** Upper bound of the max_pages_limit parameter, init_out.max_pages is u16 */
+#define FUSE_MAX_PAGES_LIMIT_MAX 65535
+
 /** Bias for fi->writectr, meaning new writepages must not be sent */
 #define FUSE_NOWRITE INT_MIN
 
@@ -226,6 +229,12 @@ struct fuse_file {
 
 	/** Has flock been performed on this file? */
 	bool flock:1;
+
+#ifdef CONFIG_FUSE_PASSTHROUGH
+	/** Backing file for FOPEN_PASSTHROUGH and the creds to access it */
+	struct file *passthrough;
+	const struct cred *passthrough_cred;
+#endif
 };
 
 /** One input argument of a request */
@@ -372,6 +381,9 @@ struct fuse_req {
 	void *argbuf;
 #endif
 
+	/** Per-CPU input queue this request was queued on, if any */
+	struct fuse_iqueue_cpu *iqc;
+
 	/** fuse_mount this request belongs to */
 	struct fuse_mount *fm;
 };
@@ -414,6 +426,27 @@ struct fuse_iqueue_ops {
 /** /dev/fuse input queue operations */
 extern const struct fuse_iqueue_ops fuse_dev_fiq_ops;
 
+/**
+ * Per-CPU input queue
+ *
+ * Once the device has been cloned, regular requests are queued on the CPU
+ * that submitted them, and preferably read by a daemon thread running on
+ * the same CPU.  This keeps concurrent readers off fiq->lock.
+ */
+struct fuse_iqueue_cpu {
+	/** Lock protecting the pending list */
+	spinlock_t lock;
+
+	/** The list of pending requests */
+	struct list_head pending;
+
+	/** Readers last running on this CPU are waiting on this */
+	wait_queue_head_t waitq;
+
+	/** The CPU this queue belongs to */
+	unsigned int cpu;
+};
+
 struct fuse_iqueue {
 	/** Connection established */
 	unsigned connected;
@@ -430,6 +463,18 @@ struct fuse_iqueue {
 	/** The list of pending requests */
 	struct list_head pending;
 
+	/** Per-CPU lists of pending requests, set up on first device clone */
+	struct fuse_iqueue_cpu __percpu *cpu_queues;
+
+	/** Number of requests on the per-CPU lists */
+	atomic_t cpu_pending;
+
+	/** CPUs with requests on their per-CPU list */
+	cpumask_var_t cpu_pending_mask;
+
+	/** CPUs which may have readers sleeping on their per-CPU queue */
+	cpumask_var_t cpu_readers;
+
 	/** Pending interrupts */
 	struct list_head interrupts;
 
@@ -784,6 +829,12 @@ struct fuse_conn {
 	/* Does the filesystem support per inode DAX? */
 	unsigned int inode_dax:1;
 
+	/* Passthrough of read/write/mmap to backing files */
+	unsigned int passthrough:1;
+
+	/** Maximum stack depth of passthrough backing files */
+	int max_stack_depth;
+
 	/** The number of requests waiting for completion */
 	atomic_t num_waiting;
 
@@ -833,6 +884,11 @@ struct fuse_conn {
 
 	/* New writepages go into this bucket */
 	struct fuse_sync_bucket __rcu *curr_bucket;
+
+#ifdef CONFIG_FUSE_PASSTHROUGH
+	/** IDR for backing files ids */
+	struct idr backing_files_map;
+#endif
 };
 
 /*
@@ -1316,4 +1372,47 @@ struct fuse_file *fuse_file_open(struct fuse_mount *fm, u64 nodeid,
 void fuse_file_release(struct inode *inode, struct fuse_file *ff,
 		       unsigned int open_flags, fl_owner_t id, bool isdir);
 
+/* passthrough.c */
+#ifdef CONFIG_FUSE_PASSTHROUGH
+void fuse_backing_files_init(struct fuse_conn *fc);
+void fuse_backing_files_free(struct fuse_conn *fc);
+int fuse_backing_open(struct fuse_conn *fc, struct fuse_backing_map *map);
+int fuse_backing_close(struct fuse_conn *fc, int backing_id);
+void fuse_passthrough_open(struct fuse_conn *fc, struct fuse_file *ff,
+			   int backing_id, unsigned int open_flags);
+void fuse_passthrough_release(struct fuse_file *ff);
+
+static inline bool fuse_file_passthrough(struct fuse_file *ff)
+{
+	return ff->passthrough;
+}
+#else
+static inline void fuse_backing_files_init(struct fuse_conn *fc) {}
+static inline void fuse_backing_files_free(struct fuse_conn *fc) {}
+static inline int fuse_backing_open(struct fuse_conn *fc,
+				    struct fuse_backing_map *map)
+{
+	return -EOPNOTSUPP;
+}
+static inline int fuse_backing_close(struct fuse_conn *fc, int backing_id)
+{
+	return -EOPNOTSUPP;
+}
+static inline void fuse_passthrough_open(struct fuse_conn *fc,
+					 struct fuse_file *ff, int backing_id,
+					 unsigned int open_flags)
+{
+	ff->open_flags &= ~FOPEN_PASSTHROUGH;
+}
+static inline void fuse_passthrough_release(struct fuse_file *ff) {}
+static inline bool fuse_file_passthrough(struct fuse_file *ff)
+{
+	return false;
+}
+#endif
+
+ssize_t fuse_passthrough_read_iter(struct kiocb *iocb, struct iov_iter *to);
+ssize_t fuse_passthrough_write_iter(struct kiocb *iocb, struct iov_iter *from);
+int fuse_passthrough_mmap(struct file *file, struct vm_area_struct *vma);
+
 #endif /* _FS_FUSE_I_H */
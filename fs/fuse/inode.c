@@ -51,6 +51,16 @@ MODULE_PARM_DESC(max_user_congthresh,
  "Global limit for the maximum congestion threshold an "
  "unprivileged user can set");
 
+static int set_max_pages_limit(const char *val, const struct kernel_param *kp);
+
+static unsigned int max_pages_limit = FUSE_MAX_MAX_PAGES;
+module_param_call(max_pages_limit, set_max_pages_limit, param_get_uint,
+		  &max_pages_limit, 0644);
+__MODULE_PARM_TYPE(max_pages_limit, "uint");
+MODULE_PARM_DESC(max_pages_limit,
+ "Maximum number of pages a server can ask to be used in a single request; "
+ "if raised, also the readahead window offered to new connections");
+
 #define FUSE_DEFAULT_BLKSIZE 512
 
 /** Maximum number of outstanding background requests */
@@ -834,7 +844,8 @@ void fuse_conn_init(struct fuse_conn *fc, struct fuse_mount *fm,
 	fc->pid_ns = get_pid_ns(task_active_pid_ns(current));
 	fc->user_ns = get_user_ns(user_ns);
 	fc->max_pages = FUSE_DEFAULT_MAX_PAGES_PER_REQ;
-	fc->max_pages_limit = FUSE_MAX_MAX_PAGES;
+	fc->max_pages_limit = READ_ONCE(max_pages_limit);
+	fuse_backing_files_init(fc);
 
 	INIT_LIST_HEAD(&fc->mounts);
 	list_add(&fm->fc_entry, &fc->mounts);
@@ -850,8 +861,12 @@ void fuse_conn_put(struct fuse_conn *fc)
 
 		if (IS_ENABLED(CONFIG_FUSE_DAX))
 			fuse_dax_conn_free(fc);
+		fuse_backing_files_free(fc);
 		if (fiq->ops->release)
 			fiq->ops->release(fiq);
+		free_percpu(fiq->cpu_queues);
+		free_cpumask_var(fiq->cpu_pending_mask);
+		free_cpumask_var(fiq->cpu_readers);
 		put_pid_ns(fc->pid_ns);
 		put_user_ns(fc->user_ns);
 		bucket = rcu_dereference_protected(fc->curr_bucket, 1);
@@ -1066,6 +1081,11 @@ static int set_global_limit(const char *val, const struct kernel_param *kp)
 	return 0;
 }
 
+static int set_max_pages_limit(const char *val, const struct kernel_param *kp)
+{
+	return param_set_uint_minmax(val, kp, 1, FUSE_MAX_PAGES_LIMIT_MAX);
+}
+
 static void process_init_limits(struct fuse_conn *fc, struct fuse_init_out *arg)
 {
 	int cap_sys_admin = capable(CAP_SYS_ADMIN);
@@ -1099,6 +1119,21 @@ struct fuse_init_args {
 	struct fuse_init_out out;
 };
 
+/*
+ * Largest readahead window the server may pick.  Only if max_pages_limit was
+ * raised above the default cap is this more than the bdi default, so that
+ * fuse_readahead() can keep several large READ requests in flight.
+ */
+static unsigned long fuse_max_ra_pages(struct fuse_mount *fm)
+{
+	unsigned long ra_pages = fm->sb->s_bdi->ra_pages;
+
+	if (fm->fc->max_pages_limit > FUSE_MAX_MAX_PAGES)
+		ra_pages = max_t(unsigned long, ra_pages,
+				 fm->fc->max_pages_limit);
+	return ra_pages;
+}
+
 static void process_init_reply(struct fuse_mount *fm, struct fuse_args *args,
 			       int error)
 {
@@ -1189,14 +1224,21 @@ static void process_init_reply(struct fuse_mount *fm, struct fuse_args *args,
 				fc->setxattr_ext = 1;
 			if (flags & FUSE_SECURITY_CTX)
 				fc->init_security = 1;
+			if (IS_ENABLED(CONFIG_FUSE_PASSTHROUGH) &&
+			    (flags & FUSE_PASSTHROUGH) &&
+			    arg->max_stack_depth > 0 &&
+			    arg->max_stack_depth <= FILESYSTEM_MAX_STACK_DEPTH) {
+				fc->passthrough = 1;
+				fc->max_stack_depth = arg->max_stack_depth;
+				fm->sb->s_stack_depth = arg->max_stack_depth;
+			}
 		} else {
 			ra_pages = fc->max_read / PAGE_SIZE;
 			fc->no_lock = 1;
 			fc->no_flock = 1;
 		}
 
-		fm->sb->s_bdi->ra_pages =
-				min(fm->sb->s_bdi->ra_pages, ra_pages);
+		fm->sb->s_bdi->ra_pages = min(fuse_max_ra_pages(fm), ra_pages);
 		fc->minor = arg->minor;
 		fc->max_write = arg->minor < 5 ? 4096 : arg->max_write;
 		fc->max_write = max_t(unsigned, 4096, fc->max_write);
@@ -1222,7 +1264,7 @@ void fuse_send_init(struct fuse_mount *fm)
 
 	ia->in.major = FUSE_KERNEL_VERSION;
 	ia->in.minor = FUSE_KERNEL_MINOR_VERSION;
-	ia->in.max_readahead = fm->sb->s_bdi->ra_pages * PAGE_SIZE;
+	ia->in.max_readahead = fuse_max_ra_pages(fm) * PAGE_SIZE;
 	flags =
 		FUSE_ASYNC_READ | FUSE_POSIX_LOCKS | FUSE_ATOMIC_O_TRUNC |
 		FUSE_EXPORT_SUPPORT | FUSE_BIG_WRITES | FUSE_DONT_MASK |
@@ -1243,6 +1285,8 @@ void fuse_send_init(struct fuse_mount *fm)
 #endif
 	if (fm->fc->auto_submounts)
 		flags |= FUSE_SUBMOUNTS;
+	if (IS_ENABLED(CONFIG_FUSE_PASSTHROUGH))
+		flags |= FUSE_PASSTHROUGH;
 
 	ia->in.flags = flags;
 	ia->in.flags2 = flags >> 32;
@@ -1435,6 +1479,7 @@ static int fuse_fill_super_submount(struct super_block *sb,
 	sb->s_time_gran = parent_sb->s_time_gran;
 	sb->s_blocksize = parent_sb->s_blocksize;
 	sb->s_blocksize_bits = parent_sb->s_blocksize_bits;
+	sb->s_stack_depth = parent_sb->s_stack_depth;
 	sb->s_subtype = kstrdup(parent_sb->s_subtype, GFP_KERNEL);
 	if (parent_sb->s_subtype && !sb->s_subtype)
 		return -ENOMEM;
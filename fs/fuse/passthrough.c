@@ -0,0 +1,291 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * FUSE passthrough to backing files.
+ *
+ * A server that merely forwards I/O to files on another filesystem can
+ * register such a file with FUSE_DEV_IOC_BACKING_OPEN and return the
+ * resulting id together with FOPEN_PASSTHROUGH in the OPEN/CREATE reply.
+ * Reads, writes and mmap of that open file are then performed directly on
+ * the backing file, without a round trip through the server.
+ */
+
+#include "fuse_i.h"
+
+#include <linux/file.h>
+#include <linux/uio.h>
+
+struct fuse_backing {
+	struct file *file;
+	const struct cred *cred;
+	refcount_t count;
+	struct rcu_head rcu;
+};
+
+static struct fuse_backing *fuse_backing_get(struct fuse_backing *fb)
+{
+	if (fb && refcount_inc_not_zero(&fb->count))
+		return fb;
+	return NULL;
+}
+
+static void fuse_backing_free(struct fuse_backing *fb)
+{
+	fput(fb->file);
+	put_cred(fb->cred);
+	kfree_rcu(fb, rcu);
+}
+
+static void fuse_backing_put(struct fuse_backing *fb)
+{
+	if (fb && refcount_dec_and_test(&fb->count))
+		fuse_backing_free(fb);
+}
+
+void fuse_backing_files_init(struct fuse_conn *fc)
+{
+	idr_init(&fc->backing_files_map);
+}
+
+static int fuse_backing_id_free(int id, void *p, void *data)
+{
+	struct fuse_backing *fb = p;
+
+	WARN_ON_ONCE(refcount_read(&fb->count) != 1);
+	fuse_backing_free(fb);
+	return 0;
+}
+
+void fuse_backing_files_free(struct fuse_conn *fc)
+{
+	idr_for_each(&fc->backing_files_map, fuse_backing_id_free, NULL);
+	idr_destroy(&fc->backing_files_map);
+}
+
+int fuse_backing_open(struct fuse_conn *fc, struct fuse_backing_map *map)
+{
+	struct file *file;
+	struct super_block *backing_sb;
+	struct fuse_backing *fb = NULL;
+	int res;
+
+	/* The server can hand out access to any file it could open itself */
+	res = -EPERM;
+	if (!fc->passthrough || !capable(CAP_SYS_ADMIN))
+		goto out;
+
+	res = -EINVAL;
+	if (map->flags || map->padding)
+		goto out;
+
+	file = fget(map->fd);
+	res = -EBADF;
+	if (!file)
+		goto out;
+
+	res = -EOPNOTSUPP;
+	if (!file->f_op->read_iter || !file->f_op->write_iter)
+		goto out_fput;
+
+	backing_sb = file_inode(file)->i_sb;
+	res = -ELOOP;
+	if (backing_sb->s_stack_depth >= fc->max_stack_depth)
+		goto out_fput;
+
+	fb = kmalloc(sizeof(*fb), GFP_KERNEL);
+	res = -ENOMEM;
+	if (!fb)
+		goto out_fput;
+
+	fb->cred = prepare_creds();
+	if (!fb->cred) {
+		kfree(fb);
+		fb = NULL;
+		goto out_fput;
+	}
+	fb->file = file;
+	refcount_set(&fb->count, 1);
+
+	idr_preload(GFP_KERNEL);
+	spin_lock(&fc->lock);
+	res = idr_alloc_cyclic(&fc->backing_files_map, fb, 1, 0, GFP_ATOMIC);
+	spin_unlock(&fc->lock);
+	idr_preload_end();
+	if (res < 0) {
+		fuse_backing_free(fb);
+		fb = NULL;
+	}
+	goto out;
+
+out_fput:
+	fput(file);
+out:
+	pr_debug("%s: fb=0x%p, ret=%i\n", __func__, fb, res);
+	return res;
+}
+
+int fuse_backing_close(struct fuse_conn *fc, int backing_id)
+{
+	struct fuse_backing *fb;
+
+	if (!fc->passthrough || !capable(CAP_SYS_ADMIN))
+		return -EPERM;
+
+	if (backing_id <= 0)
+		return -EINVAL;
+
+	spin_lock(&fc->lock);
+	fb = idr_remove(&fc->backing_files_map, backing_id);
+	spin_unlock(&fc->lock);
+	if (!fb)
+		return -ENOENT;
+
+	/* Files already opened in passthrough mode keep their own reference */
+	fuse_backing_put(fb);
+	return 0;
+}
+
+static struct fuse_backing *fuse_backing_lookup(struct fuse_conn *fc,
+						int backing_id)
+{
+	struct fuse_backing *fb;
+
+	rcu_read_lock();
+	fb = idr_find(&fc->backing_files_map, backing_id);
+	fb = fuse_backing_get(fb);
+	rcu_read_unlock();
+
+	return fb;
+}
+
+/*
+ * Set up passthrough for a file the server opened with FOPEN_PASSTHROUGH.
+ * If that fails, the file silently falls back to regular FUSE I/O.
+ */
+void fuse_passthrough_open(struct fuse_conn *fc, struct fuse_file *ff,
+			   int backing_id, unsigned int open_flags)
+{
+	struct fuse_backing *fb;
+	struct file *file;
+
+	ff->open_flags &= ~FOPEN_PASSTHROUGH;
+	if (!fc->passthrough || (ff->open_flags & FOPEN_DIRECT_IO))
+		return;
+
+	fb = fuse_backing_lookup(fc, backing_id);
+	if (!fb)
+		return;
+
+	/* Own open file, so that the access mode and O_APPEND match */
+	open_flags &= ~(O_CREAT | O_EXCL | O_NOCTTY | O_TRUNC);
+	file = dentry_open(&fb->file->f_path, open_flags, fb->cred);
+	if (IS_ERR(file))
+		goto out;
+
+	ff->passthrough = file;
+	ff->passthrough_cred = get_cred(fb->cred);
+	ff->open_flags |= FOPEN_PASSTHROUGH;
+out:
+	fuse_backing_put(fb);
+}
+
+void fuse_passthrough_release(struct fuse_file *ff)
+{
+	if (!ff->passthrough)
+		return;
+
+	fput(ff->passthrough);
+	ff->passthrough = NULL;
+	put_cred(ff->passthrough_cred);
+	ff->passthrough_cred = NULL;
+}
+
+static rwf_t fuse_iocb_to_rwf(int ifl)
+{
+	rwf_t flags = 0;
+
+	if (ifl & IOCB_NOWAIT)
+		flags |= RWF_NOWAIT;
+	if (ifl & IOCB_HIPRI)
+		flags |= RWF_HIPRI;
+	if (ifl & IOCB_DSYNC)
+		flags |= RWF_DSYNC;
+	if (ifl & IOCB_SYNC)
+		flags |= RWF_SYNC;
+
+	return flags;
+}
+
+ssize_t fuse_passthrough_read_iter(struct kiocb *iocb, struct iov_iter *to)
+{
+	struct file *file = iocb->ki_filp;
+	struct fuse_file *ff = file->private_data;
+	const struct cred *old_cred;
+	ssize_t ret;
+
+	if (!iov_iter_count(to))
+		return 0;
+
+	old_cred = override_creds(ff->passthrough_cred);
+	ret = vfs_iter_read(ff->passthrough, to, &iocb->ki_pos,
+			    fuse_iocb_to_rwf(iocb->ki_flags));
+	revert_creds(old_cred);
+
+	file_accessed(file);
+	return ret;
+}
+
+ssize_t fuse_passthrough_write_iter(struct kiocb *iocb, struct iov_iter *from)
+{
+	struct file *file = iocb->ki_filp;
+	struct fuse_file *ff = file->private_data;
+	struct inode *inode = file_inode(file);
+	const struct cred *old_cred;
+	rwf_t flags;
+	ssize_t ret;
+
+	if (!iov_iter_count(from))
+		return 0;
+
+	flags = fuse_iocb_to_rwf(iocb->ki_flags);
+	if (iocb->ki_flags & IOCB_APPEND)
+		flags |= RWF_APPEND;
+
+	if (iocb->ki_flags & IOCB_NOWAIT) {
+		if (!inode_trylock(inode))
+			return -EAGAIN;
+	} else {
+		inode_lock(inode);
+	}
+	old_cred = override_creds(ff->passthrough_cred);
+	file_start_write(ff->passthrough);
+	ret = vfs_iter_write(ff->passthrough, from, &iocb->ki_pos, flags);
+	file_end_write(ff->passthrough);
+	revert_creds(old_cred);
+	fuse_write_update_attr(inode, iocb->ki_pos, ret);
+	inode_unlock(inode);
+
+	return ret;
+}
+
+int fuse_passthrough_mmap(struct file *file, struct vm_area_struct *vma)
+{
+	struct fuse_file *ff = file->private_data;
+	struct file *backing_file = ff->passthrough;
+	const struct cred *old_cred;
+	int ret;
+
+	if (!backing_file->f_op->mmap)
+		return -ENODEV;
+
+	if (WARN_ON(file != vma->vm_file))
+		return -EIO;
+
+	vma_set_file(vma, backing_file);
+
+	old_cred = override_creds(ff->passthrough_cred);
+	ret = call_mmap(vma->vm_file, vma);
+	revert_creds(old_cred);
+	file_accessed(file);
+
+	return ret;
+}
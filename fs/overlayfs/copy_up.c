@@ -193,6 +193,39 @@ static int ovl_copy_fileattr(struct inode *inode, struct path *old,
 	return ovl_real_fileattr_set(new, &newfa);
 }
 
+/*
+ * Copy one chunk of data.  Filesystems such as NFS, CIFS and FUSE can copy
+ * within the server through ->copy_file_range() without pulling the data
+ * through the page cache, so prefer that when lower and upper share it.
+ * The method is called directly instead of through vfs_copy_file_range(),
+ * because we already hold freeze protection on the upper fs.
+ */
+static ssize_t ovl_copy_up_chunk(struct file *old_file, loff_t *old_pos,
+				 struct file *new_file, loff_t *new_pos,
+				 size_t len, bool *try_copy_range)
+{
+	ssize_t bytes;
+
+	if (*try_copy_range) {
+		bytes = new_file->f_op->copy_file_range(old_file, *old_pos,
+							new_file, *new_pos,
+							len, 0);
+		if (bytes > 0) {
+			*old_pos += bytes;
+			*new_pos += bytes;
+			/* Splice the rest of this file after a short copy */
+			if (bytes < len)
+				*try_copy_range = false;
+			return bytes;
+		}
+		/* Don't bother again for the rest of this file */
+		*try_copy_range = false;
+	}
+
+	return do_splice_direct(old_file, old_pos, new_file, new_pos,
+				len, SPLICE_F_MOVE);
+}
+
 static int ovl_copy_up_data(struct ovl_fs *ofs, struct path *old,
 			    struct path *new, loff_t len)
 {
@@ -204,6 +237,7 @@ static int ovl_copy_up_data(struct ovl_fs *ofs, struct path *old,
 	loff_t data_pos = -1;
 	loff_t hole_len;
 	bool skip_hole = false;
+	bool try_copy_range;
 	int error = 0;
 
 	if (len == 0)
@@ -230,6 +264,10 @@ static int ovl_copy_up_data(struct ovl_fs *ofs, struct path *old,
 	    old_file->f_op->llseek)
 		skip_hole = true;
 
+	try_copy_range = new_file->f_op->copy_file_range &&
+			 new_file->f_op->copy_file_range ==
+			 old_file->f_op->copy_file_range;
+
 	while (len) {
 		size_t this_len = OVL_COPY_UP_CHUNK_SIZE;
 		long bytes;
@@ -272,9 +310,9 @@ static int ovl_copy_up_data(struct ovl_fs *ofs, struct path *old,
 			}
 		}
 
-		bytes = do_splice_direct(old_file, &old_pos,
-					 new_file, &new_pos,
-					 this_len, SPLICE_F_MOVE);
+		bytes = ovl_copy_up_chunk(old_file, &old_pos,
+					  new_file, &new_pos,
+					  this_len, &try_copy_range);
 		if (bytes <= 0) {
 			error = bytes;
 			break;
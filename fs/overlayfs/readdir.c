@@ -15,6 +15,17 @@
 #include <linux/ratelimit.h>
 #include "overlayfs.h"
 
+/*
+ * Kept caches are only freed when they become stale or with the inode, and
+ * directory inodes with cached children are rarely evicted, so this is off by
+ * default.
+ */
+static bool ovl_dir_cache_keep;
+module_param_named(dir_cache_keep, ovl_dir_cache_keep, bool, 0644);
+MODULE_PARM_DESC(dir_cache_keep,
+		 "Keep merged directory contents cached after last close "
+		 "(unbounded memory use)");
+
 struct ovl_cache_entry {
 	unsigned int len;
 	unsigned int type;
@@ -235,21 +246,36 @@ void ovl_dir_cache_free(struct inode *inode)
 	}
 }
 
-static void ovl_cache_put(struct ovl_dir_file *od, struct dentry *dentry)
+static void ovl_cache_unref(struct ovl_dir_cache *cache)
 {
-	struct ovl_dir_cache *cache = od->cache;
-
 	WARN_ON(cache->refcount <= 0);
 	cache->refcount--;
 	if (!cache->refcount) {
-		if (ovl_dir_cache(d_inode(dentry)) == cache)
-			ovl_set_dir_cache(d_inode(dentry), NULL);
-
 		ovl_cache_free(&cache->entries);
 		kfree(cache);
 	}
 }
 
+/*
+ * The merged cache attached to the inode holds a reference of its own, so
+ * that it can outlive the open files and be reused by the next opener as
+ * long as the directory version did not change.  It is only detached here if
+ * it should not be kept around; otherwise it goes away when it becomes stale
+ * or when the inode is evicted.
+ */
+static void ovl_cache_put(struct ovl_dir_file *od, struct dentry *dentry)
+{
+	struct inode *inode = d_inode(dentry);
+	struct ovl_dir_cache *cache = od->cache;
+
+	if (ovl_dir_cache(inode) == cache && cache->refcount == 2 &&
+	    !READ_ONCE(ovl_dir_cache_keep)) {
+		ovl_set_dir_cache(inode, NULL);
+		ovl_cache_unref(cache);
+	}
+	ovl_cache_unref(cache);
+}
+
 static int ovl_fill_merge(struct dir_context *ctx, const char *name,
 			  int namelen, loff_t offset, u64 ino,
 			  unsigned int d_type)
@@ -402,12 +428,16 @@ static struct ovl_dir_cache *ovl_cache_get(struct dentry *dentry)
 		return cache;
 	}
 	ovl_set_dir_cache(d_inode(dentry), NULL);
+	/* Open files still using the stale cache hold their own references */
+	if (cache)
+		ovl_cache_unref(cache);
 
 	cache = kzalloc(sizeof(struct ovl_dir_cache), GFP_KERNEL);
 	if (!cache)
 		return ERR_PTR(-ENOMEM);
 
-	cache->refcount = 1;
+	/* One reference for the caller, one for the inode */
+	cache->refcount = 2;
 	INIT_LIST_HEAD(&cache->entries);
 	cache->root = RB_ROOT;
 
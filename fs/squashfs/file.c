@@ -39,6 +39,7 @@
 #include "squashfs_fs_sb.h"
 #include "squashfs_fs_i.h"
 #include "squashfs.h"
+#include "page_actor.h"
 
 /*
  * Locate cache slot in range [offset, index] for specified inode.  If
@@ -495,6 +496,127 @@ static int squashfs_readpage(struct file *file, struct page *page)
 }
 
 
+static void squashfs_readahead(struct readahead_control *ractl)
+{
+	struct inode *inode = ractl->mapping->host;
+	struct squashfs_sb_info *msblk = inode->i_sb->s_fs_info;
+	size_t mask = (1UL << msblk->block_log) - 1;
+	unsigned short shift = msblk->block_log - PAGE_SHIFT;
+	loff_t start = readahead_pos(ractl) & ~mask;
+	size_t len = readahead_length(ractl) + readahead_pos(ractl) - start;
+	struct squashfs_page_actor *actor;
+	unsigned int nr_pages = 0;
+	struct page **pages;
+	int i, file_end = i_size_read(inode) >> msblk->block_log;
+	unsigned int max_pages = 1UL << shift;
+
+	/* Always read whole datablocks, so each one is decompressed once */
+	readahead_expand(ractl, start, (len | mask) + 1);
+
+	pages = kmalloc_array(max_pages, sizeof(void *), GFP_KERNEL);
+	if (!pages)
+		return;
+
+	actor = squashfs_page_actor_init_special(pages, max_pages, 0);
+	if (!actor)
+		goto out;
+
+	for (;;) {
+		pgoff_t index;
+		int res, bsize;
+		u64 block = 0;
+		unsigned int expected;
+
+		/*
+		 * Stop each batch at the end of the datablock, in case the
+		 * window couldn't be expanded to start on a block boundary.
+		 */
+		nr_pages = __readahead_batch(ractl, pages, max_pages -
+				(readahead_index(ractl) & (max_pages - 1)));
+		if (!nr_pages)
+			break;
+
+		if (page_offset(pages[0]) >= i_size_read(inode))
+			goto skip_pages;
+
+		index = pages[0]->index >> shift;
+		if ((pages[nr_pages - 1]->index >> shift) != index)
+			goto skip_pages;
+
+		/*
+		 * The tail-end fragment is shared with other files, leave it
+		 * to squashfs_readpage() which goes through the fragment cache.
+		 */
+		if (index == file_end && squashfs_i(inode)->fragment_block !=
+						SQUASHFS_INVALID_BLK)
+			goto skip_pages;
+
+		expected = index == file_end ?
+			   (i_size_read(inode) & (msblk->block_size - 1)) :
+			    msblk->block_size;
+
+		bsize = read_blocklist(inode, index, &block);
+		if (bsize <= 0)
+			goto skip_pages;
+
+		if (nr_pages < max_pages || expected < msblk->block_size) {
+			/*
+			 * Only part of the block is wanted, because some pages
+			 * are already cached or this is the end of the file:
+			 * go through an intermediate buffer.
+			 */
+			struct squashfs_cache_entry *buffer;
+			int offset = pages[0]->index & (max_pages - 1);
+
+			buffer = squashfs_get_datablock(inode->i_sb, block,
+							bsize);
+			if (buffer->error) {
+				squashfs_cache_put(buffer);
+				goto skip_pages;
+			}
+
+			expected -= min_t(unsigned int, expected,
+					  offset * PAGE_SIZE);
+			for (i = 0; i < nr_pages; i++, offset++) {
+				int avail = min_t(int, expected, PAGE_SIZE);
+
+				squashfs_fill_page(pages[i], buffer,
+						   offset * PAGE_SIZE, avail);
+				expected -= avail;
+			}
+
+			squashfs_cache_put(buffer);
+			goto skip_pages;
+		}
+
+		/* Decompress the whole block directly into the page cache */
+		res = squashfs_read_data(inode->i_sb, block, bsize, NULL,
+					 actor);
+
+		if (res == expected) {
+			for (i = 0; i < nr_pages; i++) {
+				flush_dcache_page(pages[i]);
+				SetPageUptodate(pages[i]);
+			}
+		}
+
+skip_pages:
+		/*
+		 * Pages left !Uptodate are retried through
+		 * squashfs_readpage(), which reports any error.
+		 */
+		for (i = 0; i < nr_pages; i++) {
+			unlock_page(pages[i]);
+			put_page(pages[i]);
+		}
+	}
+
+	kfree(actor);
+out:
+	kfree(pages);
+}
+
 const struct address_space_operations squashfs_aops = {
-	.readpage = squashfs_readpage
+	.readpage = squashfs_readpage,
+	.readahead = squashfs_readahead
 };
@@ -293,6 +293,22 @@ xfs_buf_free_pages(
 	bp->b_flags &= ~_XBF_PAGES;
 }
 
+static void
+xfs_buf_free_callback(
+	struct callback_head	*cb)
+{
+	struct xfs_buf		*bp = container_of(cb, struct xfs_buf, b_rcu);
+
+	xfs_buf_free_maps(bp);
+	kmem_cache_free(xfs_buf_cache, bp);
+}
+
+/*
+ * Buffer cache lookups walk the hash and take a reference without holding the
+ * pag_buf_lock, so the buffer structure itself must not be freed until an RCU
+ * grace period has expired. The data the buffer caches is never looked at by
+ * a lookup that fails to gain a reference, so it can be freed immediately.
+ */
 static void
 xfs_buf_free(
 	struct xfs_buf		*bp)
@@ -306,8 +322,7 @@ xfs_buf_free(
 	else if (bp->b_flags & _XBF_KMEM)
 		kmem_free(bp->b_addr);
 
-	xfs_buf_free_maps(bp);
-	kmem_cache_free(xfs_buf_cache, bp);
+	call_rcu(&bp->b_rcu, xfs_buf_free_callback);
 }
 
 static int
@@ -560,11 +575,42 @@ xfs_buf_find(
 	pag = xfs_perag_get(btp->bt_mount,
 			    xfs_daddr_to_agno(btp->bt_mount, cmap.bm_bn));
 
+	/*
+	 * Cache hits vastly outnumber misses, so look the buffer up without the
+	 * pag_buf_lock first. The buffer structure is RCU freed, and a buffer
+	 * whose last reference has been dropped is either about to be removed
+	 * from the hash or revived for the LRU under the pag_buf_lock, so we
+	 * can only take a reference if the hold count is not already zero.
+	 */
+	rcu_read_lock();
+	bp = rhashtable_lookup(&pag->pag_buf_hash, &cmap, xfs_buf_hash_params);
+	if (bp && atomic_inc_not_zero(&bp->b_hold)) {
+		rcu_read_unlock();
+		XFS_STATS_INC(btp->bt_mount, xb_get_lockless);
+		goto found;
+	}
+	rcu_read_unlock();
+
+	/* No match found */
+	if (!bp && !new_bp) {
+		XFS_STATS_INC(btp->bt_mount, xb_miss_lockless);
+		xfs_perag_put(pag);
+		return -ENOENT;
+	}
+
+	/*
+	 * Insertion has to be serialised against other inserts and the final
+	 * release of a buffer, so recheck for a racing insert under the lock.
+	 * This also resolves a racing final release: nothing in the hash can
+	 * have a zero hold count while we hold the pag_buf_lock, so a buffer
+	 * that was being revived for the LRU is found here.
+	 */
 	spin_lock(&pag->pag_buf_lock);
 	bp = rhashtable_lookup_fast(&pag->pag_buf_hash, &cmap,
 				    xfs_buf_hash_params);
 	if (bp) {
 		atomic_inc(&bp->b_hold);
+		spin_unlock(&pag->pag_buf_lock);
 		goto found;
 	}
 
@@ -585,7 +631,6 @@ xfs_buf_find(
 	return 0;
 
 found:
-	spin_unlock(&pag->pag_buf_lock);
 	xfs_perag_put(pag);
 
 	if (!xfs_buf_trylock(bp)) {
@@ -972,10 +1017,11 @@ xfs_buf_rele(
 	/*
 	 * We grab the b_lock here first to serialise racing xfs_buf_rele()
 	 * calls. The pag_buf_lock being taken on the last reference only
-	 * serialises against racing lookups in xfs_buf_find(). IOWs, the second
-	 * to last reference we drop here is not serialised against the last
-	 * reference until we take bp->b_lock. Hence if we don't grab b_lock
-	 * first, the last "release" reference can win the race to the lock and
+	 * serialises against racing locked lookups in xfs_buf_find(); lockless
+	 * lookups never take a reference once the count hits zero. IOWs, the
+	 * second to last reference we drop here is not serialised against the
+	 * last reference until we take bp->b_lock. Hence if we don't grab
+	 * b_lock first, the last "release" reference can win the race to the lock and
 	 * free the buffer before the second-to-last reference is processed,
 	 * leading to a use-after-free scenario.
 	 */
@@ -2275,6 +2321,8 @@ xfs_buf_init(void)
 void
 xfs_buf_terminate(void)
 {
+	/* wait for RCU freed buffers before destroying the cache */
+	rcu_barrier();
 	kmem_cache_destroy(xfs_buf_cache);
 }
 
@@ -29,6 +29,7 @@ xfs_param_t xfs_params = {
 	.inherit_nodfrg	= {	0,		1,		1	},
 	.fstrm_timer	= {	1,		30*100,		3600*100},
 	.blockgc_timer	= {	1,		300,		3600*24},
+	.bulkstat_ags	= {	0,		0,		256	},
 };
 
 struct xfs_globals xfs_globals = {
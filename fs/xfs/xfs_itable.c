@@ -15,6 +15,7 @@
 #include "xfs_ialloc.h"
 #include "xfs_ialloc_btree.h"
 #include "xfs_iwalk.h"
+#include "xfs_ag.h"
 #include "xfs_itable.h"
 #include "xfs_error.h"
 #include "xfs_icache.h"
@@ -245,6 +246,249 @@ xfs_bulkstat_already_done(
 	       startino != XFS_AGINO_TO_INO(mp, agno, agino);
 }
 
+/*
+ * Parallel Bulk Stat
+ * ==================
+ *
+ * On filesystems with many AGs, most of the time spent in bulkstat goes to
+ * reading inode clusters and instantiating inodes, and that can be spread over
+ * the AGs.  If the bulkstat_parallel_ags sysctl is set, we fan the walk out
+ * over up to that many AGs at a time.  The caller walks the first AG itself,
+ * and the others are walked by workers on the system unbound workqueue.  Each
+ * walk stats the inodes of one AG into a kernel buffer; the caller then copies
+ * the records out to userspace in AG order, so the results and the inode
+ * cursor are exactly what a sequential walk would have produced.
+ *
+ * We only fan out as far as the in-core inode counts of the AGs say is needed
+ * to fill the request, and each AG only collects as many records as the AGs
+ * before it leave room for.  If a single AG can fill the request, we walk
+ * sequentially, so that large AGs never cost more than the sequential walk.
+ */
+
+/* Maximum number of records collected per call. */
+#define XFS_BULKSTAT_AG_MAX_RECS	1024
+
+struct xfs_bstat_ag {
+	struct work_struct	work;
+	struct xfs_ibulk	breq;	/* per-AG cursor and record count */
+	struct xfs_bstat_chunk	bc;
+	struct xfs_bulkstat	*recs;
+	xfs_agnumber_t		agno;
+	int			error;
+};
+
+/* Stash a bulkstat record in the per-AG buffer. */
+static int
+xfs_bulkstat_ag_fmt(
+	struct xfs_ibulk		*breq,
+	const struct xfs_bulkstat	*bstat)
+{
+	struct xfs_bstat_ag		*bag;
+
+	bag = container_of(breq, struct xfs_bstat_ag, breq);
+	bag->recs[breq->ocount++] = *bstat;
+	return breq->ocount == breq->icount ? -ECANCELED : 0;
+}
+
+/* Stat the inodes of a single AG into the per-AG buffer. */
+static void
+xfs_bulkstat_ag(
+	struct xfs_bstat_ag	*bag)
+{
+	struct xfs_mount	*mp = bag->breq.mp;
+	struct xfs_trans	*tp;
+	int			error;
+
+	/*
+	 * Grab an empty transaction so that we can use its recursive buffer
+	 * locking abilities to detect cycles in the inobt without deadlocking.
+	 */
+	error = xfs_trans_alloc_empty(mp, &tp);
+	if (error)
+		goto out;
+
+	error = xfs_iwalk(mp, tp, bag->breq.startino, XFS_IWALK_SAME_AG,
+			xfs_bulkstat_iwalk, bag->breq.icount, &bag->bc);
+	xfs_trans_cancel(tp);
+out:
+	/* Errors are reported in AG order by the caller. */
+	bag->error = error;
+}
+
+static void
+xfs_bulkstat_ag_work(
+	struct work_struct	*work)
+{
+	xfs_bulkstat_ag(container_of(work, struct xfs_bstat_ag, work));
+}
+
+/*
+ * How many of the @want records still needed could come from @agno?  Use the
+ * in-core AGI counters if we have them, otherwise assume that the AG can fill
+ * the request on its own.
+ */
+static unsigned int
+xfs_bulkstat_ag_estimate(
+	struct xfs_mount	*mp,
+	xfs_agnumber_t		agno,
+	unsigned int		want)
+{
+	struct xfs_perag	*pag;
+	unsigned int		est = want;
+
+	pag = xfs_perag_get(mp, agno);
+	if (pag->pagi_init)
+		est = min_t(unsigned int, want,
+				pag->pagi_count - pag->pagi_freecount);
+	xfs_perag_put(pag);
+	return est;
+}
+
+/*
+ * Copy the records of one AG out to userspace and move the cursor along.
+ * Returns 1 if the caller should keep going with the next AG, 0 if the walk
+ * has to stop here, or a negative errno.
+ */
+static int
+xfs_bulkstat_ag_copyout(
+	struct xfs_ibulk	*breq,
+	bulkstat_one_fmt_pf	formatter,
+	struct xfs_bstat_ag	*bag)
+{
+	struct xfs_mount	*mp = breq->mp;
+	unsigned int		i;
+	int			error;
+
+	for (i = 0; i < bag->breq.ocount; i++) {
+		error = formatter(breq, &bag->recs[i]);
+		if (error == -ECANCELED) {
+			breq->startino = bag->recs[i].bs_ino + 1;
+			return 0;
+		}
+		if (error) {
+			breq->startino = bag->recs[i].bs_ino;
+			return error;
+		}
+	}
+
+	/*
+	 * The walk stopped early because it filled its buffer or hit an
+	 * error, so pick up from its cursor next time.
+	 */
+	breq->startino = bag->breq.startino;
+	if (bag->error == -ECANCELED)
+		return 0;
+	if (bag->error)
+		return bag->error;
+
+	breq->startino = XFS_AGINO_TO_INO(mp, bag->agno + 1, 0);
+	return 1;
+}
+
+/* Bulkstat up to @nr_ags AGs in parallel, starting at the cursor. */
+static int
+xfs_bulkstat_parallel(
+	struct xfs_ibulk	*breq,
+	bulkstat_one_fmt_pf	formatter,
+	unsigned int		nr_ags)
+{
+	struct xfs_mount	*mp = breq->mp;
+	struct xfs_bstat_ag	*bags;
+	xfs_agnumber_t		agno;
+	unsigned int		want;
+	unsigned int		nr_queued;
+	unsigned int		i;
+	int			error = 0;
+
+	want = min_t(unsigned int, breq->icount - breq->ocount,
+			XFS_BULKSTAT_AG_MAX_RECS);
+
+	bags = kmem_zalloc(nr_ags * sizeof(*bags), KM_MAYFAIL);
+	if (!bags)
+		return -ENOMEM;
+
+	agno = XFS_INO_TO_AGNO(mp, breq->startino);
+	for (i = 0; i < nr_ags && want > 0; i++) {
+		struct xfs_bstat_ag	*bag = &bags[i];
+
+		/* This AG can't contribute more than what is left over. */
+		bag->recs = kvcalloc(want, sizeof(struct xfs_bulkstat),
+				GFP_KERNEL);
+		bag->bc.buf = kmem_zalloc(sizeof(struct xfs_bulkstat),
+				KM_MAYFAIL);
+		if (!bag->recs || !bag->bc.buf) {
+			error = -ENOMEM;
+			break;
+		}
+		bag->bc.formatter = xfs_bulkstat_ag_fmt;
+		bag->bc.breq = &bag->breq;
+		bag->agno = agno + i;
+		bag->breq.mp = mp;
+		bag->breq.mnt_userns = breq->mnt_userns;
+		bag->breq.icount = want;
+		bag->breq.startino = i ? XFS_AGINO_TO_INO(mp, bag->agno, 0) :
+					 breq->startino;
+		want -= xfs_bulkstat_ag_estimate(mp, bag->agno, want);
+
+		/* The first AG is walked by the caller below. */
+		INIT_WORK(&bag->work, xfs_bulkstat_ag_work);
+		if (i)
+			queue_work(system_unbound_wq, &bag->work);
+	}
+	nr_queued = i;
+
+	if (nr_queued) {
+		if (!error)
+			xfs_bulkstat_ag(&bags[0]);
+		for (i = 1; i < nr_queued; i++)
+			flush_work(&bags[i].work);
+	}
+
+	/* Only copy out AGs up to the first one that couldn't be set up. */
+	for (i = 0; i < nr_queued && !error; i++) {
+		int	ret;
+
+		ret = xfs_bulkstat_ag_copyout(breq, formatter, &bags[i]);
+		if (ret <= 0) {
+			error = ret;
+			break;
+		}
+	}
+
+	for (i = 0; i < nr_ags; i++) {
+		kvfree(bags[i].recs);
+		kmem_free(bags[i].bc.buf);
+	}
+	kmem_free(bags);
+	return error;
+}
+
+/*
+ * How many AGs should the next bulkstat pass walk in parallel?  Only as many
+ * as it takes to fill the request, going by the in-core inode counts.
+ */
+static inline unsigned int
+xfs_bulkstat_nr_ags(
+	struct xfs_ibulk	*breq)
+{
+	struct xfs_mount	*mp = breq->mp;
+	xfs_agnumber_t		agno = XFS_INO_TO_AGNO(mp, breq->startino);
+	unsigned int		max_ags;
+	unsigned int		want;
+	unsigned int		nr;
+
+	if (xfs_bulkstat_ags <= 1 || (breq->flags & XFS_IBULK_SAME_AG))
+		return 0;
+
+	max_ags = min_t(xfs_agnumber_t, xfs_bulkstat_ags,
+			mp->m_sb.sb_agcount - agno);
+	want = min_t(unsigned int, breq->icount - breq->ocount,
+			XFS_BULKSTAT_AG_MAX_RECS);
+	for (nr = 0; nr < max_ags && want > 0; nr++)
+		want -= xfs_bulkstat_ag_estimate(mp, agno + nr, want);
+	return nr;
+}
+
 /* Return stat information in bulk (by-inode) for the filesystem. */
 int
 xfs_bulkstat(
@@ -256,6 +500,7 @@ xfs_bulkstat(
 		.breq		= breq,
 	};
 	struct xfs_trans	*tp;
+	unsigned int		nr_ags;
 	int			error;
 
 	if (breq->mnt_userns != &init_user_ns) {
@@ -266,6 +511,18 @@ xfs_bulkstat(
 	if (xfs_bulkstat_already_done(breq->mp, breq->startino))
 		return 0;
 
+	/*
+	 * Keep going until we've returned something, so that userspace only
+	 * sees an empty buffer at the end of the filesystem.  Once a single AG
+	 * can fill the request, walk sequentially from there.
+	 */
+	while ((nr_ags = xfs_bulkstat_nr_ags(breq)) > 1) {
+		error = xfs_bulkstat_parallel(breq, formatter, nr_ags);
+		if (error || breq->ocount > 0 ||
+		    xfs_bulkstat_already_done(breq->mp, breq->startino))
+			goto out_error;
+	}
+
 	bc.buf = kmem_zalloc(sizeof(struct xfs_bulkstat),
 			KM_MAYFAIL);
 	if (!bc.buf)
@@ -284,6 +541,7 @@ xfs_bulkstat(
 	xfs_trans_cancel(tp);
 out:
 	kmem_free(bc.buf);
+out_error:
 
 	/*
 	 * We found some inodes, so clear the error status and return them.
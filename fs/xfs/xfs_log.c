@@ -1675,6 +1675,7 @@ xlog_grant_push_threshold(
 	int		threshold_block;
 	int		threshold_cycle;
 	int		free_threshold;
+	int		push_blocks;
 
 	ASSERT(BTOBB(need_bytes) < log->l_logBBsize);
 
@@ -1692,9 +1693,22 @@ xlog_grant_push_threshold(
 	if (free_blocks >= free_threshold)
 		return NULLCOMMITLSN;
 
+	/*
+	 * Pushing the tail only just far enough to get back above the free
+	 * space threshold means the AIL chases the threshold in lots of small
+	 * pushes and reservations keep waiting on the tail. Instead, push
+	 * further ahead the deeper below the threshold we are, so under heavy
+	 * log space pressure each AIL pass writes back a larger, better sorted
+	 * batch of metadata. This acts as a low water mark that is never more
+	 * than half the log beyond the tail.
+	 */
+	push_blocks = free_threshold + (free_threshold - free_blocks);
+	push_blocks = min(push_blocks, max(free_threshold,
+					   log->l_logBBsize >> 1));
+
 	xlog_crack_atomic_lsn(&log->l_tail_lsn, &threshold_cycle,
 						&threshold_block);
-	threshold_block += free_threshold;
+	threshold_block += push_blocks;
 	if (threshold_block >= log->l_logBBsize) {
 		threshold_block -= log->l_logBBsize;
 		threshold_cycle += 1;
@@ -1715,10 +1729,9 @@ xlog_grant_push_threshold(
 
 /*
  * Push the tail of the log if we need to do so to maintain the free log space
- * thresholds set out by xlog_grant_push_threshold.  We may need to adopt a
- * policy which pushes on an lsn which is further along in the log once we
- * reach the high water mark.  In this manner, we would be creating a low water
- * mark.
+ * thresholds set out by xlog_grant_push_threshold.  Once we drop below the high
+ * water mark, the push target is moved further along in the log in proportion
+ * to the space shortfall, creating a low water mark for the AIL to push to.
  */
 STATIC void
 xlog_grant_push_ail(
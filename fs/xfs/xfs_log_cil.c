@@ -61,15 +61,57 @@ xlog_cil_ctx_alloc(void)
 	ctx = kmem_zalloc(sizeof(*ctx), KM_NOFS);
 	INIT_LIST_HEAD(&ctx->committing);
 	INIT_LIST_HEAD(&ctx->busy_extents);
+	INIT_LIST_HEAD(&ctx->log_items);
 	INIT_WORK(&ctx->push_work, xlog_cil_push_work);
 	return ctx;
 }
 
+/*
+ * Aggregate the CIL per-cpu structures into the context being pushed. Only the
+ * CPUs that committed items into this context have anything to aggregate, and
+ * they are recorded in the context's CPU mask. CPUs that have since gone
+ * offline keep their per-cpu structures, so they are still aggregated here.
+ *
+ * Must be called with the context lock held exclusively so that no transaction
+ * commit can be modifying the per-cpu structures concurrently.
+ */
+static void
+xlog_cil_pcp_aggregate(
+	struct xfs_cil		*cil,
+	struct xfs_cil_ctx	*ctx)
+{
+	struct xlog_cil_pcp	*cilpcp;
+	int			cpu;
+
+	for_each_cpu(cpu, &ctx->cil_pcpmask) {
+		cilpcp = per_cpu_ptr(cil->xc_pcp, cpu);
+
+		ctx->ticket->t_curr_res += cilpcp->space_reserved;
+		cilpcp->space_reserved = 0;
+
+		if (cilpcp->space_used) {
+			atomic_add(cilpcp->space_used, &ctx->space_used);
+			cilpcp->space_used = 0;
+		}
+		if (!list_empty(&cilpcp->busy_extents))
+			list_splice_init(&cilpcp->busy_extents,
+					&ctx->busy_extents);
+		if (!list_empty(&cilpcp->log_items))
+			list_splice_init(&cilpcp->log_items, &ctx->log_items);
+	}
+}
+
 static void
 xlog_cil_ctx_switch(
 	struct xfs_cil		*cil,
 	struct xfs_cil_ctx	*ctx)
 {
+	struct xlog		*log = cil->xc_log;
+
+	set_bit(XLOG_CIL_EMPTY, &cil->xc_flags);
+	set_bit(XLOG_CIL_PCP_SPACE, &cil->xc_flags);
+	atomic_set(&cil->xc_iclog_hdrs, XLOG_CIL_BLOCKING_SPACE_LIMIT(log) /
+			(log->l_iclog_size - log->l_iclog_hsize));
 	ctx->sequence = ++cil->xc_current_sequence;
 	ctx->cil = cil;
 	cil->xc_ctx = ctx;
@@ -441,6 +483,12 @@ xlog_cil_insert_format_items(
  * if the change requires additional log metadata. If it does, take that space
  * as well. Remove the amount of space we added to the checkpoint ticket from
  * the current transaction ticket so that the accounting works out correctly.
+ *
+ * All of this is done in the per-cpu CIL structure of the CPU we are running
+ * on, so concurrent commits on different CPUs do not serialise on a global
+ * lock. Items that are already in the CIL stay on whatever per-cpu list they
+ * were first inserted on; their order ID is updated instead so the push can
+ * restore the commit order when it aggregates the per-cpu lists.
  */
 static void
 xlog_cil_insert_items(
@@ -450,10 +498,13 @@ xlog_cil_insert_items(
 	struct xfs_cil		*cil = log->l_cilp;
 	struct xfs_cil_ctx	*ctx = cil->xc_ctx;
 	struct xfs_log_item	*lip;
+	struct xlog_cil_pcp	*cilpcp;
 	int			len = 0;
 	int			diff_iovecs = 0;
 	int			iclog_space;
 	int			iovhdr_res = 0, split_res = 0, ctx_res = 0;
+	int			space_used;
+	uint32_t		order;
 
 	ASSERT(tp);
 
@@ -463,16 +514,11 @@ xlog_cil_insert_items(
 	 */
 	xlog_cil_insert_format_items(log, tp, &len, &diff_iovecs);
 
-	spin_lock(&cil->xc_cil_lock);
-
 	/* account for space used by new iovec headers  */
 	iovhdr_res = diff_iovecs * sizeof(xlog_op_header_t);
 	len += iovhdr_res;
-	ctx->nvecs += diff_iovecs;
 
-	/* attach the transaction to the CIL if it has any busy extents */
-	if (!list_empty(&tp->t_busy))
-		list_splice_init(&tp->t_busy, &ctx->busy_extents);
+	cilpcp = get_cpu_ptr(cil->xc_pcp);
 
 	/*
 	 * Now transfer enough transaction reservation to the context ticket
@@ -480,27 +526,62 @@ xlog_cil_insert_items(
 	 * reservation has to grow as well as the current reservation as we
 	 * steal from tickets so we can correctly determine the space used
 	 * during the transaction commit.
+	 *
+	 * The checkpoint unit reservation is taken by the first commit into
+	 * the context. Test the XLOG_CIL_EMPTY bit first so we don't do an
+	 * atomic op in the fast path. The bit can only be set again by the
+	 * push, which holds the context lock exclusively.
 	 */
-	if (ctx->ticket->t_curr_res == 0) {
+	if (test_bit(XLOG_CIL_EMPTY, &cil->xc_flags) &&
+	    test_and_clear_bit(XLOG_CIL_EMPTY, &cil->xc_flags))
 		ctx_res = ctx->ticket->t_unit_res;
-		ctx->ticket->t_curr_res = ctx_res;
-		tp->t_ticket->t_curr_res -= ctx_res;
-	}
 
-	/* do we need space for more log record headers? */
+	/*
+	 * Do we need space for more log record headers? We can no longer see
+	 * exactly where the iclog boundaries of the checkpoint fall, so every
+	 * commit steals the record headers its own changes could need until
+	 * enough have been taken for a checkpoint at the blocking limit. Once
+	 * the CIL is over the blocking limit the checkpoint may need more than
+	 * that, so keep stealing from every commit. This can steal more than
+	 * we need, but that's OK.
+	 */
 	iclog_space = log->l_iclog_size - log->l_iclog_hsize;
-	if (len > 0 && (ctx->space_used / iclog_space !=
-				(ctx->space_used + len) / iclog_space)) {
-		split_res = (len + iclog_space - 1) / iclog_space;
+	space_used = atomic_read(&ctx->space_used) + cilpcp->space_used + len;
+	if (len > 0 && (atomic_read(&cil->xc_iclog_hdrs) > 0 ||
+			space_used >= XLOG_CIL_BLOCKING_SPACE_LIMIT(log))) {
+		int	hdrs = (len + iclog_space - 1) / iclog_space;
+
+		split_res = hdrs;
 		/* need to take into account split region headers, too */
 		split_res *= log->l_iclog_hsize + sizeof(struct xlog_op_header);
-		ctx->ticket->t_unit_res += split_res;
-		ctx->ticket->t_curr_res += split_res;
-		tp->t_ticket->t_curr_res -= split_res;
-		ASSERT(tp->t_ticket->t_curr_res >= len);
+		atomic_sub(hdrs, &cil->xc_iclog_hdrs);
 	}
+	cilpcp->space_reserved += ctx_res + split_res;
+	tp->t_ticket->t_curr_res -= ctx_res + split_res;
+	ASSERT(!split_res || tp->t_ticket->t_curr_res >= len);
 	tp->t_ticket->t_curr_res -= len;
-	ctx->space_used += len;
+
+	/*
+	 * Batch the space usage on this CPU until it has used its share of the
+	 * background push threshold, then fold it into the context. Once the
+	 * CIL is over the push threshold, account accurately so the push and
+	 * throttling decisions see every commit.
+	 */
+	if (!test_bit(XLOG_CIL_PCP_SPACE, &cil->xc_flags)) {
+		atomic_add(len, &ctx->space_used);
+	} else if (cilpcp->space_used + len >= XLOG_CIL_PCP_SPACE_LIMIT(log)) {
+		space_used = atomic_add_return(cilpcp->space_used + len,
+				&ctx->space_used);
+		cilpcp->space_used = 0;
+		if (space_used >= XLOG_CIL_SPACE_LIMIT(log))
+			clear_bit(XLOG_CIL_PCP_SPACE, &cil->xc_flags);
+	} else {
+		cilpcp->space_used += len;
+	}
+
+	/* attach the transaction to the CIL if it has any busy extents */
+	if (!list_empty(&tp->t_busy))
+		list_splice_init(&tp->t_busy, &cilpcp->busy_extents);
 
 	/*
 	 * If we've overrun the reservation, dump the tx details before we move
@@ -518,26 +599,27 @@ xlog_cil_insert_items(
 	}
 
 	/*
-	 * Now (re-)position everything modified at the tail of the CIL.
-	 * We do this here so we only need to take the CIL lock once during
-	 * the transaction commit.
+	 * Now update the order of everything modified in the transaction and
+	 * insert the items into the CIL if they aren't already there. Only
+	 * the owner of the item's lock can be modifying li_cil here, and the
+	 * per-cpu list is protected by having preemption disabled.
 	 */
+	if (!cpumask_test_cpu(smp_processor_id(), &ctx->cil_pcpmask))
+		cpumask_test_and_set_cpu(smp_processor_id(),
+				&ctx->cil_pcpmask);
+	order = atomic_inc_return(&ctx->order_id);
 	list_for_each_entry(lip, &tp->t_items, li_trans) {
 
 		/* Skip items which aren't dirty in this transaction. */
 		if (!test_bit(XFS_LI_DIRTY, &lip->li_flags))
 			continue;
 
-		/*
-		 * Only move the item if it isn't already at the tail. This is
-		 * to prevent a transient list_empty() state when reinserting
-		 * an item that is already the only item in the CIL.
-		 */
-		if (!list_is_last(&lip->li_cil, &cil->xc_cil))
-			list_move_tail(&lip->li_cil, &cil->xc_cil);
+		lip->li_order_id = order;
+		if (!list_empty(&lip->li_cil))
+			continue;
+		list_add_tail(&lip->li_cil, &cilpcp->log_items);
 	}
-
-	spin_unlock(&cil->xc_cil_lock);
+	put_cpu_ptr(cilpcp);
 
 	if (tp->t_ticket->t_curr_res < 0)
 		xfs_force_shutdown(log->l_mp, SHUTDOWN_LOG_IO_ERROR);
@@ -858,6 +940,23 @@ xlog_cil_write_commit_record(
 	return error;
 }
 
+/*
+ * Sort log items by the order ID they were last committed with. list_sort() is
+ * a stable sort, so items committed by the same transaction keep the relative
+ * order they were inserted into the per-cpu list with.
+ */
+static int
+xlog_cil_order_cmp(
+	void			*priv,
+	const struct list_head	*a,
+	const struct list_head	*b)
+{
+	struct xfs_log_item	*l1 = container_of(a, struct xfs_log_item, li_cil);
+	struct xfs_log_item	*l2 = container_of(b, struct xfs_log_item, li_cil);
+
+	return l1->li_order_id > l2->li_order_id;
+}
+
 /*
  * Push the Committed Item List to the log.
  *
@@ -921,7 +1020,7 @@ xlog_cil_push_work(
 	 * move on to a new sequence number and so we have to be able to push
 	 * this sequence again later.
 	 */
-	if (list_empty(&cil->xc_cil)) {
+	if (test_bit(XLOG_CIL_EMPTY, &cil->xc_flags)) {
 		cil->xc_push_seq = 0;
 		spin_unlock(&cil->xc_push_lock);
 		goto out_skip;
@@ -980,16 +1079,23 @@ xlog_cil_push_work(
 
 	/*
 	 * Pull all the log vectors off the items in the CIL, and remove the
-	 * items from the CIL. We don't need the CIL lock here because it's only
-	 * needed on the transaction commit side which is currently locked out
-	 * by the flush lock.
+	 * items from the CIL. We don't need any CIL locking here because the
+	 * transaction commit side is currently locked out by the flush lock.
+	 *
+	 * The items were inserted into per-cpu lists, so gather them into the
+	 * context and sort them back into commit order first. That keeps the
+	 * relative order of items in the checkpoint the same as it would be
+	 * with a single global list, which log recovery relies on.
 	 */
+	xlog_cil_pcp_aggregate(cil, ctx);
+	list_sort(NULL, &ctx->log_items, xlog_cil_order_cmp);
+
 	lv = NULL;
 	num_iovecs = 0;
-	while (!list_empty(&cil->xc_cil)) {
+	while (!list_empty(&ctx->log_items)) {
 		struct xfs_log_item	*item;
 
-		item = list_first_entry(&cil->xc_cil,
+		item = list_first_entry(&ctx->log_items,
 					struct xfs_log_item, li_cil);
 		list_del_init(&item->li_cil);
 		if (!ctx->lv_chain)
@@ -1161,13 +1267,13 @@ xlog_cil_push_background(
 	 * The cil won't be empty because we are called while holding the
 	 * context lock so whatever we added to the CIL will still be there
 	 */
-	ASSERT(!list_empty(&cil->xc_cil));
+	ASSERT(!test_bit(XLOG_CIL_EMPTY, &cil->xc_flags));
 
 	/*
 	 * Don't do a background push if we haven't used up all the
 	 * space available yet.
 	 */
-	if (cil->xc_ctx->space_used < XLOG_CIL_SPACE_LIMIT(log)) {
+	if (atomic_read(&cil->xc_ctx->space_used) < XLOG_CIL_SPACE_LIMIT(log)) {
 		up_read(&cil->xc_ctx_lock);
 		return;
 	}
@@ -1196,10 +1302,11 @@ xlog_cil_push_background(
 	 * The ctx->xc_push_lock provides the serialisation necessary for safely
 	 * using the lockless waitqueue_active() check in this context.
 	 */
-	if (cil->xc_ctx->space_used >= XLOG_CIL_BLOCKING_SPACE_LIMIT(log) ||
+	if (atomic_read(&cil->xc_ctx->space_used) >=
+			XLOG_CIL_BLOCKING_SPACE_LIMIT(log) ||
 	    waitqueue_active(&cil->xc_push_wait)) {
 		trace_xfs_log_cil_wait(log, cil->xc_ctx->ticket);
-		ASSERT(cil->xc_ctx->space_used < log->l_logsize);
+		ASSERT(atomic_read(&cil->xc_ctx->space_used) < log->l_logsize);
 		xlog_wait(&cil->xc_push_wait, &cil->xc_push_lock);
 		return;
 	}
@@ -1248,7 +1355,8 @@ xlog_cil_push_now(
 	 * there's no work we need to do.
 	 */
 	spin_lock(&cil->xc_push_lock);
-	if (list_empty(&cil->xc_cil) || push_seq <= cil->xc_push_seq) {
+	if (test_bit(XLOG_CIL_EMPTY, &cil->xc_flags) ||
+	    push_seq <= cil->xc_push_seq) {
 		spin_unlock(&cil->xc_push_lock);
 		return;
 	}
@@ -1267,7 +1375,7 @@ xlog_cil_empty(
 	bool		empty = false;
 
 	spin_lock(&cil->xc_push_lock);
-	if (list_empty(&cil->xc_cil))
+	if (test_bit(XLOG_CIL_EMPTY, &cil->xc_flags))
 		empty = true;
 	spin_unlock(&cil->xc_push_lock);
 	return empty;
@@ -1435,7 +1543,7 @@ xlog_cil_force_seq(
 	 * we would have found the context on the committing list.
 	 */
 	if (sequence == cil->xc_current_sequence &&
-	    !list_empty(&cil->xc_cil)) {
+	    !test_bit(XLOG_CIL_EMPTY, &cil->xc_flags)) {
 		spin_unlock(&cil->xc_push_lock);
 		goto restart;
 	}
@@ -1490,10 +1598,23 @@ xlog_cil_init(
 {
 	struct xfs_cil	*cil;
 	struct xfs_cil_ctx *ctx;
+	struct xlog_cil_pcp *cilpcp;
+	int		cpu;
 
 	cil = kmem_zalloc(sizeof(*cil), KM_MAYFAIL);
 	if (!cil)
 		return -ENOMEM;
+
+	cil->xc_pcp = alloc_percpu(struct xlog_cil_pcp);
+	if (!cil->xc_pcp)
+		goto out_destroy_cil;
+
+	for_each_possible_cpu(cpu) {
+		cilpcp = per_cpu_ptr(cil->xc_pcp, cpu);
+		INIT_LIST_HEAD(&cilpcp->busy_extents);
+		INIT_LIST_HEAD(&cilpcp->log_items);
+	}
+
 	/*
 	 * Limit the CIL pipeline depth to 4 concurrent works to bound the
 	 * concurrency the log spinlocks will be exposed to.
@@ -1502,11 +1623,9 @@ xlog_cil_init(
 			XFS_WQFLAGS(WQ_FREEZABLE | WQ_MEM_RECLAIM | WQ_UNBOUND),
 			4, log->l_mp->m_super->s_id);
 	if (!cil->xc_push_wq)
-		goto out_destroy_cil;
+		goto out_free_pcp;
 
-	INIT_LIST_HEAD(&cil->xc_cil);
 	INIT_LIST_HEAD(&cil->xc_committing);
-	spin_lock_init(&cil->xc_cil_lock);
 	spin_lock_init(&cil->xc_push_lock);
 	init_waitqueue_head(&cil->xc_push_wait);
 	init_rwsem(&cil->xc_ctx_lock);
@@ -1520,6 +1639,8 @@ xlog_cil_init(
 
 	return 0;
 
+out_free_pcp:
+	free_percpu(cil->xc_pcp);
 out_destroy_cil:
 	kmem_free(cil);
 	return -ENOMEM;
@@ -1535,8 +1656,9 @@ xlog_cil_destroy(
 		kmem_free(log->l_cilp->xc_ctx);
 	}
 
-	ASSERT(list_empty(&log->l_cilp->xc_cil));
+	ASSERT(test_bit(XLOG_CIL_EMPTY, &log->l_cilp->xc_flags));
 	destroy_workqueue(log->l_cilp->xc_push_wq);
+	free_percpu(log->l_cilp->xc_pcp);
 	kmem_free(log->l_cilp);
 }
 
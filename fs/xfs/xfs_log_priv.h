@@ -242,9 +242,11 @@ struct xfs_cil_ctx {
 	xfs_lsn_t		commit_lsn;	/* chkpt commit record lsn */
 	struct xlog_in_core	*commit_iclog;
 	struct xlog_ticket	*ticket;	/* chkpt ticket */
-	int			nvecs;		/* number of regions */
-	int			space_used;	/* aggregate size of regions */
+	atomic_t		space_used;	/* aggregate size of regions */
+	atomic_t		order_id;	/* item ordering in chkpt */
 	struct list_head	busy_extents;	/* busy extents in chkpt */
+	struct list_head	log_items;	/* log items in chkpt */
+	struct cpumask		cil_pcpmask;	/* CPUs that hold items */
 	struct xfs_log_vec	*lv_chain;	/* logvecs being pushed */
 	struct list_head	iclog_entry;
 	struct list_head	committing;	/* ctx committing list */
@@ -252,6 +254,22 @@ struct xfs_cil_ctx {
 	struct work_struct	push_work;
 };
 
+/*
+ * Per-cpu CIL tracking items and space.
+ *
+ * Transaction commits insert their items into the list on the CPU they are
+ * running on and account their space and reservation there, so the commit fast
+ * path does not bounce a global lock and cacheline between CPUs. The push
+ * aggregates the per-cpu state into the context while it holds the context
+ * lock exclusively.
+ */
+struct xlog_cil_pcp {
+	int32_t			space_used;
+	uint32_t		space_reserved;
+	struct list_head	busy_extents;
+	struct list_head	log_items;
+};
+
 /*
  * Committed Item List structure
  *
@@ -270,9 +288,10 @@ struct xfs_cil_ctx {
  */
 struct xfs_cil {
 	struct xlog		*xc_log;
-	struct list_head	xc_cil;
-	spinlock_t		xc_cil_lock;
+	unsigned long		xc_flags;
+	atomic_t		xc_iclog_hdrs;
 	struct workqueue_struct	*xc_push_wq;
+	struct xlog_cil_pcp __percpu *xc_pcp;
 
 	struct rw_semaphore	xc_ctx_lock ____cacheline_aligned_in_smp;
 	struct xfs_cil_ctx	*xc_ctx;
@@ -287,6 +306,10 @@ struct xfs_cil {
 	wait_queue_head_t	xc_push_wait;	/* background push throttle */
 } ____cacheline_aligned_in_smp;
 
+/* xc_flags bit values */
+#define	XLOG_CIL_EMPTY		1	/* no items in the current context */
+#define	XLOG_CIL_PCP_SPACE	2	/* batch space accounting per-cpu */
+
 /*
  * The amount of log space we allow the CIL to aggregate is difficult to size.
  * Whatever we choose, we have to make sure we can get a reservation for the
@@ -376,6 +399,16 @@ struct xfs_cil {
 #define XLOG_CIL_BLOCKING_SPACE_LIMIT(log)	\
 	(XLOG_CIL_SPACE_LIMIT(log) * 2)
 
+/*
+ * Until the CIL reaches the background push threshold, space usage is batched
+ * in the per-cpu CIL structures and only folded into the context once a CPU has
+ * accumulated its share of the threshold. This bounds the amount of space the
+ * global counter can lag by to a single background push threshold, which still
+ * keeps the CIL under the blocking limit.
+ */
+#define XLOG_CIL_PCP_SPACE_LIMIT(log)	\
+	(XLOG_CIL_SPACE_LIMIT(log) / num_online_cpus())
+
 /*
  * ticket grant locks, queues and accounting have their own cachlines
  * as these are quite hot and can be operated on concurrently.
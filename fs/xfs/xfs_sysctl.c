@@ -194,6 +194,15 @@ static struct ctl_table xfs_table[] = {
 		.extra1		= &xfs_params.blockgc_timer.min,
 		.extra2		= &xfs_params.blockgc_timer.max,
 	},
+	{
+		.procname	= "bulkstat_parallel_ags",
+		.data		= &xfs_params.bulkstat_ags.val,
+		.maxlen		= sizeof(int),
+		.mode		= 0644,
+		.proc_handler	= proc_dointvec_minmax,
+		.extra1		= &xfs_params.bulkstat_ags.min,
+		.extra2		= &xfs_params.bulkstat_ags.max,
+	},
 	/* please keep this the last entry */
 #ifdef CONFIG_PROC_FS
 	{